@@ -0,0 +1,99 @@
+/* Frame scheduler. main() calls frame_present() once per pass, the
+   framebuffer is sent when it changed, but at most once per LED_FRAME_MS,
+   so a burst of keys and ticks costs one transfer. A frame is due
+   LED_FRAME_MS after the last one or when it changed, whatever is later.
+   Every full interval it waited beyond that, because a pass of the main
+   loop took too long, counts as a skipped frame. The UART command "R"
+   prints frames, skipped frames and the last and longest transfer time
+   in ms, "RC" clears them. The transfer time needs WS2812_IRQ_WINDOW,
+   otherwise _ms stops while the strip is written. LED_FRAME_MS 0 sends
+   every change at once. */
+#ifndef LED_FRAME_MS
+#define LED_FRAME_MS         16
+#endif
+
+static uint32_t _frame_last, _frame_due;
+static uint8_t _frame_waiting;
+
+static uint32_t _frame_count;
+static uint16_t _frame_skipped;
+static uint8_t _frame_time, _frame_max;
+
+static void frame_present(void);
+static void frame_clear(void);
+static void frame_dump(void);
+
+static void frame_present(void)
+{
+	uint32_t t = ms();
+#if LED_FRAME_MS
+	uint32_t late;
+#endif
+	if(!_dirty)
+	{
+		/* The last key changed nothing, there is no photon to time */
+		LATENCY_IDLE();
+		PROTO_SHOWN();
+		return;
+	}
+
+	/* Not while the binary protocol fills the framebuffer */
+	if(PROTO_HOLD())
+	{
+		return;
+	}
+
+	if(!_frame_waiting)
+	{
+		_frame_waiting = 1;
+		_frame_due = (t - _frame_last < LED_FRAME_MS) ?
+			_frame_last + LED_FRAME_MS : t;
+	}
+
+	if((int32_t)(t - _frame_due) < 0)
+	{
+		return;
+	}
+
+#if LED_FRAME_MS
+	late = (t - _frame_due) / LED_FRAME_MS;
+	_frame_skipped = (late > 0xFFFF - _frame_skipped) ?
+		0xFFFF : _frame_skipped + late;
+#endif
+
+	_frame_waiting = 0;
+	_frame_last = t;
+	led_update();
+	PROTO_SHOWN();
+
+	t = ms() - t;
+	_frame_time = (t > 255) ? 255 : t;
+	if(_frame_time > _frame_max)
+	{
+		_frame_max = _frame_time;
+	}
+
+	++_frame_count;
+}
+
+static void frame_clear(void)
+{
+	_frame_count = 0;
+	_frame_skipped = 0;
+	_frame_time = 0;
+	_frame_max = 0;
+}
+
+static void frame_dump(void)
+{
+	char s[12];
+	uart_tx_P(PSTR("FRM n="));
+	uart_tx_s(ultoa(_frame_count, s, 10));
+	uart_tx_P(PSTR(" skipped="));
+	uart_tx_s(utoa(_frame_skipped, s, 10));
+	uart_tx_P(PSTR(" ms="));
+	uart_tx_s(utoa(_frame_time, s, 10));
+	uart_tx_P(PSTR(" max="));
+	uart_tx_s(utoa(_frame_max, s, 10));
+	uart_tx_s("\r\n");
+}
@@ -0,0 +1,4 @@
+/* Host build: interrupt handlers are called by the simulation */
+#define ISR(vector)     void vector(void)
+#define sei()
+#define cli()
@@ -0,0 +1,37 @@
+/* Host build: the registers used by the firmware are plain variables */
+#include <stdint.h>
+
+static volatile uint8_t PORTB, DDRB, PINB, PORTD, DDRD, PIND, SREG;
+static volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, TIMSK0, TIFR0;
+static volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, TIMSK2, TIFR2;
+static volatile uint8_t PCICR, PCMSK2;
+static volatile uint8_t UCSR0A, UCSR0B, UCSR0C, UDR0;
+static volatile uint16_t UBRR0;
+
+#define CS00       0
+#define CS01       1
+#define CS02       2
+#define WGM01      1
+#define OCIE0A     1
+#define OCF0A      1
+
+#define CS20       0
+#define CS21       1
+#define CS22       2
+#define WGM21      1
+#define TOIE2      0
+#define OCIE2A     1
+#define OCF2A      1
+
+#define PCIE2      2
+
+#define U2X0       1
+#define DOR0       3
+#define UCSZ00     1
+#define UCSZ01     2
+#define TXEN0      3
+#define RXEN0      4
+#define UDRIE0     5
+#define RXCIE0     7
+#define UDRE0      5
+#define RXC0       7
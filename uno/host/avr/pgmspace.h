@@ -0,0 +1,8 @@
+/* Host build: flash and RAM share one address space */
+#include <stdint.h>
+
+#define PROGMEM
+#define PSTR(s)                (s)
+#define pgm_read_byte(p)       (*(const uint8_t *)(p))
+#define pgm_read_word(p)       (*(const uint16_t *)(p))
+#define pgm_read_ptr(p)        (*(void * const *)(p))
@@ -0,0 +1,44 @@
+/* Key map for IRMP builds: protocol, command, button. The protocols used
+   here have to be enabled in irmpconfig.h. The commands of other remotes
+   can be found with irmp-main-avr-uart.c. */
+static const ir_key_t _ir_keys[] PROGMEM =
+{
+	/* RC5, Philips and the custom remote */
+	IR_KEY(IRMP_RC5_PROTOCOL,       1, BTN_MODE_SMILEY),
+	IR_KEY(IRMP_RC5_PROTOCOL,       3, BTN_MODE_SNAKE),
+	IR_KEY(IRMP_RC5_PROTOCOL,       7, BTN_MODE_TETRIS),
+	IR_KEY(IRMP_RC5_PROTOCOL,       9, BTN_MODE_HISTOGRAM),
+	IR_KEY(IRMP_RC5_PROTOCOL,       2, BTN_UP_PRESSED),
+	IR_KEY(IRMP_RC5_PROTOCOL,       6, BTN_RIGHT_PRESSED),
+	IR_KEY(IRMP_RC5_PROTOCOL,       8, BTN_DOWN_PRESSED),
+	IR_KEY(IRMP_RC5_PROTOCOL,       4, BTN_LEFT_PRESSED),
+	IR_KEY(IRMP_RC5_PROTOCOL,       5, BTN_DROP_PRESSED),
+	IR_KEY(IRMP_RC5_PROTOCOL,      16, BTN_BRIGHTNESS_UP),
+	IR_KEY(IRMP_RC5_PROTOCOL,      17, BTN_BRIGHTNESS_DOWN),
+
+	/* NEC, common 21 key remote */
+	IR_KEY(IRMP_NEC_PROTOCOL,    0x0C, BTN_MODE_SMILEY),
+	IR_KEY(IRMP_NEC_PROTOCOL,    0x5E, BTN_MODE_SNAKE),
+	IR_KEY(IRMP_NEC_PROTOCOL,    0x42, BTN_MODE_TETRIS),
+	IR_KEY(IRMP_NEC_PROTOCOL,    0x4A, BTN_MODE_HISTOGRAM),
+	IR_KEY(IRMP_NEC_PROTOCOL,    0x18, BTN_UP_PRESSED),
+	IR_KEY(IRMP_NEC_PROTOCOL,    0x5A, BTN_RIGHT_PRESSED),
+	IR_KEY(IRMP_NEC_PROTOCOL,    0x52, BTN_DOWN_PRESSED),
+	IR_KEY(IRMP_NEC_PROTOCOL,    0x08, BTN_LEFT_PRESSED),
+	IR_KEY(IRMP_NEC_PROTOCOL,    0x1C, BTN_DROP_PRESSED),
+	IR_KEY(IRMP_NEC_PROTOCOL,    0x15, BTN_BRIGHTNESS_UP),
+	IR_KEY(IRMP_NEC_PROTOCOL,    0x07, BTN_BRIGHTNESS_DOWN),
+
+	/* Samsung TV, command byte and its inverse */
+	IR_KEY(IRMP_SAMSUNG32_PROTOCOL, 0xFB04, BTN_MODE_SMILEY),
+	IR_KEY(IRMP_SAMSUNG32_PROTOCOL, 0xF906, BTN_MODE_SNAKE),
+	IR_KEY(IRMP_SAMSUNG32_PROTOCOL, 0xF30C, BTN_MODE_TETRIS),
+	IR_KEY(IRMP_SAMSUNG32_PROTOCOL, 0xF10E, BTN_MODE_HISTOGRAM),
+	IR_KEY(IRMP_SAMSUNG32_PROTOCOL, 0xFA05, BTN_UP_PRESSED),
+	IR_KEY(IRMP_SAMSUNG32_PROTOCOL, 0xF50A, BTN_RIGHT_PRESSED),
+	IR_KEY(IRMP_SAMSUNG32_PROTOCOL, 0xF20D, BTN_DOWN_PRESSED),
+	IR_KEY(IRMP_SAMSUNG32_PROTOCOL, 0xF708, BTN_LEFT_PRESSED),
+	IR_KEY(IRMP_SAMSUNG32_PROTOCOL, 0xF609, BTN_DROP_PRESSED),
+	IR_KEY(IRMP_SAMSUNG32_PROTOCOL, 0xF807, BTN_BRIGHTNESS_UP),
+	IR_KEY(IRMP_SAMSUNG32_PROTOCOL, 0xF40B, BTN_BRIGHTNESS_DOWN),
+};
@@ -0,0 +1,178 @@
+/* Input to photon latency, enabled with LATENCY. A key is timed when the
+   IR interrupt queues it, when main() dispatches it and when the next
+   frame has been sent to the strip. Min, average, max and a histogram
+   for the 99th percentile are kept per interval, the UART command "L"
+   prints them and "LC" clears them. Times are in us. The key queue only
+   keeps the low 16 bits, a key waiting longer than 65 ms for main() is
+   counted short. The histogram is halved when a bin is full, so it keeps
+   the distribution in 8 bit bins. */
+#if defined(LATENCY) && LATENCY
+#define LATENCY_BINS         16
+
+#define LATENCY_KEY(us)       (_latency_key = (us))
+#define LATENCY_DISPATCH()    latency_dispatch()
+#define LATENCY_IDLE()        (_latency_pending = 0)
+
+typedef struct LATENCY_STAT
+{
+	uint32_t sum;
+	uint16_t count, min, max;
+	uint8_t bins[LATENCY_BINS];
+} latency_t;
+
+/* decode -> dispatch, dispatch -> photon, decode -> photon */
+static latency_t _latency[3];
+static const uint8_t _latency_shift[3] PROGMEM = { 9, 11, 11 };
+static uint32_t _latency_dispatch;
+static uint16_t _latency_key, _latency_decode;
+static uint8_t _latency_pending;
+
+static uint32_t latency_us(void);
+static void latency_add(uint8_t i, uint32_t us);
+static void latency_dispatch(void);
+static void latency_photon(void);
+static void latency_clear(void);
+static void latency_dump(void);
+
+/* Timer0 counts F_CPU / 64 between two _ms ticks */
+static uint32_t latency_us(void)
+{
+	uint8_t s = SREG, t;
+	uint32_t ms;
+	cli();
+	ms = _ms;
+	t = TCNT0;
+	if((TIFR0 & (1 << OCF0A)) && t < OCR0A / 2)
+	{
+		++ms;
+	}
+
+	SREG = s;
+	return ms * 1000 + (uint16_t)t * 64 / (F_CPU / 1000000);
+}
+
+static void latency_add(uint8_t i, uint32_t us)
+{
+	latency_t *l = &_latency[i];
+	uint16_t v = (us > 0xFFFF) ? 0xFFFF : us;
+	uint8_t bin = v >> pgm_read_byte(&_latency_shift[i]), b;
+
+	if(l->count == 0xFFFF)
+	{
+		return;
+	}
+
+	if(!l->count || v < l->min)
+	{
+		l->min = v;
+	}
+
+	if(v > l->max)
+	{
+		l->max = v;
+	}
+
+	l->sum += v;
+	++l->count;
+	if(++l->bins[(bin < LATENCY_BINS) ? bin : LATENCY_BINS - 1] == 255)
+	{
+		for(b = 0; b < LATENCY_BINS; ++b)
+		{
+			l->bins[b] >>= 1;
+		}
+	}
+}
+
+static void latency_dispatch(void)
+{
+	_latency_dispatch = latency_us();
+	_latency_decode = (uint16_t)_latency_dispatch - _latency_key;
+	latency_add(0, _latency_decode);
+	_latency_pending = 1;
+}
+
+/* Hooked into led_update(), the first frame after a key counts. A key
+   that changed nothing is dropped by LATENCY_IDLE() in frame_present(). */
+static void latency_photon(void)
+{
+	uint32_t now;
+	if(_latency_pending)
+	{
+		now = latency_us();
+		latency_add(1, now - _latency_dispatch);
+		latency_add(2, now - _latency_dispatch + _latency_decode);
+		_latency_pending = 0;
+	}
+}
+
+static void latency_clear(void)
+{
+	uint8_t *p = (uint8_t *)_latency;
+	uint16_t i;
+	for(i = 0; i < sizeof(_latency); ++i)
+	{
+		p[i] = 0;
+	}
+}
+
+static void latency_dump(void)
+{
+	static const char names[3][10] PROGMEM =
+	{
+		"decode", "dispatch", "total"
+	};
+
+	char s[12];
+	uint8_t i, b, shift, block = _uart_tx_block;
+	uint16_t n, total;
+	latency_t *l;
+
+	/* Longer than the transmit ring, wait instead of dropping */
+	_uart_tx_block = 1;
+	for(i = 0; i < ARRLEN(_latency); ++i)
+	{
+		l = &_latency[i];
+		uart_tx_P(PSTR("LAT "));
+		uart_tx_P(names[i]);
+		uart_tx_P(PSTR(" n="));
+		uart_tx_s(utoa(l->count, s, 10));
+		if(l->count)
+		{
+			/* Upper edge of the bin holding the 99th percentile */
+			for(b = 0, total = 0; b < LATENCY_BINS; ++b)
+			{
+				total += l->bins[b];
+			}
+
+			n = 0;
+			for(b = 0; b < LATENCY_BINS - 1; ++b)
+			{
+				n += l->bins[b];
+				if(n >= total - total / 100)
+				{
+					break;
+				}
+			}
+
+			shift = pgm_read_byte(&_latency_shift[i]);
+
+			uart_tx_P(PSTR(" min="));
+			uart_tx_s(utoa(l->min, s, 10));
+			uart_tx_P(PSTR(" avg="));
+			uart_tx_s(ultoa(l->sum / l->count, s, 10));
+			uart_tx_P(PSTR(" max="));
+			uart_tx_s(utoa(l->max, s, 10));
+			uart_tx_P(PSTR(" p99<"));
+			uart_tx_s(ultoa((uint32_t)(b + 1) << shift, s, 10));
+		}
+
+		uart_tx_s("\r\n");
+	}
+
+	_uart_tx_block = block;
+}
+#else
+#define LATENCY_KEY(us)
+#define LATENCY_DISPATCH()
+#define LATENCY_IDLE()
+#endif
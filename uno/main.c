@@ -3,45 +3,141 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <avr/pgmspace.h>
+
+#if defined(LATENCY) && LATENCY
+static void latency_photon(void);
+#define LED_SHOWN()           latency_photon()
+#endif
+
 #include "ws2812.c"
+#if defined(IRMP) && IRMP
+#include "irmp.h"
+#endif
 
 #define ARRLEN(x)             (sizeof(x) / sizeof(*x))
 
-/* RC5 */
-#define RC5_IN                PIND
-#define RC5_PIN              7
-#define RC5_TIME      1.778e-3 /* 1.778 _ms */
-#define RC5_PULSE_MIN         (uint8_t)(F_CPU / 512 * RC5_TIME * 0.4 + 0.5)
-#define RC5_PULSE_1_2         (uint8_t)(F_CPU / 512 * RC5_TIME * 0.8 + 0.5)
-#define RC5_PULSE_MAX         (uint8_t)(F_CPU / 512 * RC5_TIME * 1.2 + 0.5)
+/* Timer */
+static volatile uint32_t _ms;
 
-static volatile uint16_t rc5_data;
+static uint32_t ms(void);
+
+
+/* RC5 decoder, key queue and UART, shared with uno_tester */
+#include "uart.c"
+#include "latency.c"
+#include "rc5.c"
 
 
 /* Remote Control Buttons */
 #define BTN_MODE_SMILEY      1
 #define BTN_MODE_SNAKE       3
 #define BTN_MODE_TETRIS      7
+#define BTN_MODE_HISTOGRAM   9
 
 #define BTN_UP_PRESSED       2
 #define BTN_RIGHT_PRESSED    6
 #define BTN_DOWN_PRESSED     8
 #define BTN_LEFT_PRESSED     4
+#define BTN_DROP_PRESSED     5
 
+#define BTN_BRIGHTNESS_UP   16
+#define BTN_BRIGHTNESS_DOWN 17
 
-/* UART */
-#define UART_BAUD         9600
-#define UART_PRESCALER        (uint16_t)(F_CPU / UART_BAUD / 16 - 0.5)
+#define BTN_NONE          0xFF
 
-int16_t uart_rx(void);
+#define BRIGHTNESS_STEP     16
 
 
-/* Timer */
-static volatile uint32_t _ms;
+/* IRMP: instead of the RC5 decoder in rc5.c, Timer2 samples the input at
+   F_INTERRUPTS for the bundled multi-protocol decoder. Decoded commands
+   are translated to buttons with the key map in irkeys.h. */
+#if defined(IRMP) && IRMP
+#define IRMP_PRESCALER        (F_CPU / 8 / F_INTERRUPTS - 1)
+
+#if (IRMP_PRESCALER > 255)
+#error "F_INTERRUPTS too low for Timer2"
+#endif
 
+#define IR_KEY(p, c, b)       { p, c, b }
 
-/* Mode */
-enum { MODE_SMILEY, MODE_SNAKE, MODE_TETRIS } static _mode = MODE_SMILEY;
+typedef struct IR_KEY
+{
+	uint8_t protocol;
+	uint16_t command;
+	uint8_t btn;
+} ir_key_t;
+
+#include "irkeys.h"
+
+static uint8_t ir_button(IRMP_DATA *d);
+#endif
+
+
+/* Key state: a held button is repeated by the remote every 114 ms with
+   the same toggle bit, a new press flips it. The button is released when
+   no frame arrived for KEY_RELEASE_MS. Repeats are generated here, with
+   KEY_REPEAT_DELAY before the first one, so they do not depend on the
+   rate of the remote. */
+#define KEY_PRESS             1
+#define KEY_REPEAT            2
+#define KEY_LONG              3
+#define KEY_RELEASE           4
+
+#define KEY_RELEASE_MS      150
+
+#ifndef KEY_REPEAT_DELAY
+#define KEY_REPEAT_DELAY    250
+#endif
+
+#ifndef KEY_REPEAT_RATE
+#define KEY_REPEAT_RATE      50
+#endif
+
+#ifndef KEY_LONG_MS
+#define KEY_LONG_MS        1000
+#endif
+
+static uint16_t _key_code;
+static uint8_t _key_btn, _key_long, _key_pending;
+static uint32_t _key_last, _key_down, _key_next;
+
+static uint8_t key_state(uint8_t *btn);
+
+
+/* Mode: one row of _modes per mode, in this order. MODE_STREAM shows
+   what the binary protocol sends. */
+enum
+{
+	MODE_SMILEY,
+	MODE_SNAKE,
+	MODE_TETRIS,
+	MODE_STREAM,
+	MODE_HISTOGRAM
+} static _mode = MODE_SMILEY;
+
+/* init is called when the mode is selected, input with every key event
+   that is not a mode or brightness button, tick after period ms and
+   then after the time it returns, draw when the votes changed. All of
+   them only change the framebuffer, frame_present() sends it. */
+typedef struct MODE_DEF
+{
+	uint8_t btn;
+	void (*init)(void);
+	void (*input)(uint8_t ev, uint8_t btn);
+	uint16_t (*tick)(void);
+	void (*draw)(void);
+	uint16_t period;
+} mode_def_t;
+
+#define MODE_FN(m, f)         pgm_read_ptr(&_modes[m].f)
+
+static void mode_set(uint8_t mode);
+static void mode_period(uint16_t ms);
+static void mode_draw(void);
+static uint8_t key_global(uint8_t ev, uint8_t btn);
+
+static uint32_t _mode_ticks;
+static uint16_t _mode_period;
 
 
 /* LED Board */
@@ -54,11 +150,16 @@ static color_t black = { 0, 0, 0 };
 #define IMG_RANGE                    (255 / IMG_COUNT)
 
 static void led_image(const uint8_t *i, color_t *fg, color_t *bg);
+static uint8_t img_index(uint8_t v);
 static void img_value(uint8_t v);
+static void vote_color(uint8_t v, color_t *c);
+static void smiley_init(void);
+static void smiley_draw(void);
+static void votes_add(const uint8_t *v, uint8_t n);
 
-static uint8_t _avg = 255;
-static uint32_t _sum;
-static uint16_t _count;
+static uint8_t _smiley_face;
+
+#include "votes.c"
 
 static const uint8_t img[IMG_COUNT * IMG_BYTES] PROGMEM =
 {
@@ -70,6 +171,48 @@ static const uint8_t img[IMG_COUNT * IMG_BYTES] PROGMEM =
 };
 
 
+/* Histogram: the vote bins in 16 columns, only the cells of the bars
+   that changed are set. Unlike the smiley it is not limited to the
+   VOTE_WINDOW, the bins hold all votes since power-on and only lose
+   weight when one of them fills and all are halved. */
+#define HIST_BINS            (256 / LED_SIZE)
+
+/* Every column has its own colour and every row its own shade. A palette
+   only holds black, one colour per face and as many shades as fit. */
+#if defined(LED_PALETTE) && LED_PALETTE
+#define HIST_SHADES           ((LED_PALETTE_SIZE - 1) / IMG_COUNT)
+#if (HIST_SHADES < 1)
+#error "LED_PALETTE_SIZE too small for the histogram"
+#elif (HIST_SHADES > LED_SIZE)
+#undef HIST_SHADES
+#define HIST_SHADES          LED_SIZE
+#endif
+#else
+#define HIST_SHADES          LED_SIZE
+#endif
+
+#define HIST_STEP             (160 / HIST_SHADES)
+
+static void hist_init(void);
+static void hist_draw(void);
+
+static uint8_t _hist_heights[LED_SIZE];
+
+
+/* Binary protocol */
+#include "proto.c"
+
+#if defined(PROTO) && PROTO
+#define UART_LINE(b, n)       proto_line(b, n)
+#else
+#define UART_LINE(b, n)       uart_line(b, n)
+#endif
+
+
+/* Frame scheduler */
+#include "frame.c"
+
+
 /* Snake */
 #define SNAKE_INITIAL_LEN    4
 #define SNAKE_MAX_LEN       16
@@ -79,6 +222,8 @@ static void draw_snake(void);
 static void draw_food(void);
 static void random_food(void);
 static void snake_init(void);
+static void snake_input(uint8_t ev, uint8_t btn);
+static uint16_t snake_tick(void);
 static uint8_t snake_update(void);
 static void snake_advance(void);
 
@@ -120,9 +265,14 @@ static uint16_t _snake_update_ticks;
 
 /* Tetris */
 #define FALL_SPEED_DEFAULT 350
+#define FALL_SPEED_SOFT     50
 #define ROTATE_RIGHT         1
 #define ROTATE_LEFT          1
 
+static void tetris_init(void);
+static void tetris_input(uint8_t ev, uint8_t btn);
+static uint16_t tetris_tick(void);
+
 static void piece_undraw(void);
 static void piece_draw(void);
 static void piece_rotate_left(void);
@@ -139,6 +289,7 @@ static void field_rows(void);
 
 static uint8_t _field[LED_PIXELS];
 static volatile uint16_t _tetris_update_ticks;
+static uint8_t _soft_drop;
 
 struct
 {
@@ -190,38 +341,41 @@ struct
 };
 
 
-void uart_tx(char c)
+/* Modes */
+static const mode_def_t _modes[] PROGMEM =
 {
-	while(!(UCSR0A & (1 << UDRE0))) ;
-	UDR0 = c;
-}
+	/* MODE_SMILEY */
+	{ BTN_MODE_SMILEY, smiley_init, NULL, NULL, smiley_draw, 0 },
 
-void uart_tx_s(const char *s)
-{
-	register char c;
-	while((c = *s++))
-	{
-		uart_tx(c);
-	}
-}
+	/* MODE_SNAKE */
+	{ BTN_MODE_SNAKE, snake_init, snake_input, snake_tick, NULL,
+		SNAKE_MS_UPDATE },
+
+	/* MODE_TETRIS */
+	{ BTN_MODE_TETRIS, tetris_init, tetris_input, tetris_tick, NULL,
+		FALL_SPEED_DEFAULT },
+
+	/* MODE_STREAM */
+	{ BTN_NONE, NULL, NULL, NULL, NULL, 0 },
+
+	/* MODE_HISTOGRAM */
+	{ BTN_MODE_HISTOGRAM, hist_init, NULL, NULL, hist_draw, 0 }
+};
 
-void uart_tx_P(const char *s)
-{
-	register char c;
-	while((c = pgm_read_byte(s++)))
-	{
-		uart_tx(c);
-	}
-}
 
 int main(void)
 {
-	char buf[3], *p = buf;
+	char buf[4];
 	char s[8];
-	int16_t c;
 
-	uint32_t ticks = 0;
-	uint16_t i;
+	void (*input)(uint8_t ev, uint8_t btn);
+	uint16_t (*tick)(void);
+	uint32_t now;
+	uint8_t overflow = 0, overrun = 0;
+#if defined(PROTO) && PROTO
+	uint8_t errors = 0;
+#endif
+	uint8_t btn, ev;
 
 	led_clear(&black);
 	led_update();
@@ -232,193 +386,218 @@ int main(void)
 	OCR0A = 250;
 	TIMSK0 = (1 << OCIE0A);
 
-	/* RC5 Timer */
-	TCCR2B = (1 << CS22) | (1 << CS21);
-	TIMSK2 = (1 << TOIE2);
+#if defined(IRMP) && IRMP
+	/* IRMP Timer */
+	irmp_init();
+	TCCR2A = (1 << WGM21);
+	TCCR2B = (1 << CS21);
+	OCR2A = IRMP_PRESCALER;
+	TIMSK2 = (1 << OCIE2A);
+#else
+	rc5_init();
+#endif
 
-	/* UART Receiver */
-	UBRR0 = UART_PRESCALER;
-	UCSR0A = 0;
-	UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
-	UCSR0B = (1 << RXEN0) | (1 << TXEN0);
+	uart_init();
 
 	sei();
-	img_value(_avg);
+	mode_set(MODE_SMILEY);
 
 	for(;;)
 	{
-		if((c = uart_rx()) >= 0)
+		/* Old votes leave the window */
+		if(vote_tick())
+		{
+			vote_update();
+			mode_draw();
+		}
+
+		/* Votes and commands, every complete line is handled */
+		while(UART_LINE(buf, sizeof(buf)) >= 0)
 		{
-			if(c == '\n')
+			uint8_t val;
+			/* Votes are hex, commands start with any other letter */
+			if(buf[0] == 'I')
 			{
-				uint8_t val;
-				*p = '\0';
-				val = strtol(buf, NULL, 16);
-				p = buf;
-				_sum += val;
-				++_count;
-				_avg = _sum / _count;
-				if(_mode == MODE_SMILEY)
+				/* Brightness (intensity): "Ixx" */
+				led_brightness(strtol(buf + 1, NULL, 16));
+			}
+#if defined(LATENCY) && LATENCY
+			else if(buf[0] == 'L')
+			{
+				/* Latency: "L" prints, "LC" clears */
+				if(buf[1] == 'C')
+				{
+					latency_clear();
+				}
+				else
 				{
-					img_value(_avg);
+					latency_dump();
 				}
 			}
-			else if(p < buf + ARRLEN(buf))
+#endif
+			else if(buf[0] == 'R')
+			{
+				/* Frame rate: "R" prints, "RC" clears */
+				if(buf[1] == 'C')
+				{
+					frame_clear();
+				}
+				else
+				{
+					frame_dump();
+				}
+			}
+			else
 			{
-				*p++ = c;
+				val = strtol(buf, NULL, 16);
+				votes_add(&val, 1);
 			}
 		}
 
-		cli();
-		i = rc5_data;
-		rc5_data = 0;
-		sei();
+		if(_key_overflow != overflow)
+		{
+			overflow = _key_overflow;
+			uart_tx_P(PSTR("KEY OVERFLOW: "));
+			uart_tx_s(itoa(overflow, s, 10));
+			uart_tx_s("\r\n");
+		}
 
-		if(i)
+		if(_uart_overrun != overrun)
 		{
-			i = (i & 0x3F) | (~i >> 7 & 0x40);
+			overrun = _uart_overrun;
+			uart_tx_P(PSTR("UART OVERRUN: "));
+			uart_tx_s(itoa(overrun, s, 10));
+			uart_tx_s("\r\n");
+		}
 
-			uart_tx_P(PSTR("KEY: "));
-			uart_tx_s(itoa(i, s, 10));
+#if defined(PROTO) && PROTO
+		if(_proto_errors != errors)
+		{
+			errors = _proto_errors;
+			uart_tx_P(PSTR("PROTO ERRORS: "));
+			uart_tx_s(itoa(errors, s, 10));
 			uart_tx_s("\r\n");
+		}
+#endif
 
-			switch(i)
+		while((ev = key_state(&btn)))
+		{
+			if(ev == KEY_LONG)
 			{
-			case BTN_MODE_SMILEY:
-				_mode = MODE_SMILEY;
-				img_value(_avg);
-				break;
+				uart_tx_P(PSTR("KEY LONG: "));
+				uart_tx_s(itoa(btn, s, 10));
+				uart_tx_s("\r\n");
+				continue;
+			}
 
-			case BTN_MODE_SNAKE:
-				_mode = MODE_SNAKE;
-				snake_init();
-				led_update();
-				break;
+			if(ev == KEY_PRESS)
+			{
+				LATENCY_DISPATCH();
+				uart_tx_P(PSTR("KEY: "));
+				uart_tx_s(itoa(btn, s, 10));
+				uart_tx_s("\r\n");
+			}
 
-			case BTN_MODE_TETRIS:
-				_mode = MODE_TETRIS;
-				_tetris_update_ticks = FALL_SPEED_DEFAULT;
-				field_clear();
-				led_clear(&black);
-				piece_next();
-				break;
+			if(!key_global(ev, btn) && (input = MODE_FN(_mode, input)))
+			{
+				input(ev, btn);
+			}
+		}
 
-			default:
-				if(_mode == MODE_SNAKE)
-				{
-					switch(i)
-					{
-					case BTN_UP_PRESSED:
-						_dir = UP;
-						break;
+		/* Ticks stay on their own grid, a late one is not carried over
+		   into the next */
+		now = ms();
+		if((tick = MODE_FN(_mode, tick)) && now - _mode_ticks >= _mode_period)
+		{
+			_mode_ticks += _mode_period;
+			_mode_period = tick();
+			if(now - _mode_ticks >= _mode_period)
+			{
+				_mode_ticks = now;
+			}
+		}
 
-					case BTN_RIGHT_PRESSED:
-						_dir = RIGHT;
-						break;
+		frame_present();
+	}
 
-					case BTN_DOWN_PRESSED:
-						_dir = DOWN;
-						break;
+	return 0;
+}
 
-					case BTN_LEFT_PRESSED:
-						_dir = LEFT;
-						break;
-					}
-				}
-				else if(_mode == MODE_TETRIS)
-				{
-					switch(i)
-					{
-					case BTN_UP_PRESSED:
-						piece_undraw();
-						piece_rotate_right();
-						piece_draw();
-						led_update();
-						break;
 
-					case BTN_RIGHT_PRESSED:
-						piece_undraw();
-						piece_move_right();
-						piece_draw();
-						led_update();
-						break;
+/* Mode */
+static void mode_set(uint8_t mode)
+{
+	void (*init)(void);
+	if(mode >= ARRLEN(_modes))
+	{
+		return;
+	}
 
-					case BTN_DOWN_PRESSED:
-						piece_undraw();
-						piece_rotate_left();
-						piece_draw();
-						led_update();
-						break;
+	_mode = mode;
+#if defined(PROTO) && PROTO
+	_proto_hold = 0;
+#endif
+	if((init = MODE_FN(mode, init)))
+	{
+		init();
+	}
 
-					case BTN_LEFT_PRESSED:
-						piece_undraw();
-						piece_move_left();
-						piece_draw();
-						led_update();
-						break;
-					}
-				}
-				break;
-			}
-		}
+	_mode_ticks = ms();
+	_mode_period = pgm_read_word(&_modes[mode].period);
+}
 
+/* Time between the last tick and the next one */
+static void mode_period(uint16_t ms)
+{
+	_mode_period = ms;
+}
 
-		if(_mode == MODE_SNAKE)
+static void mode_draw(void)
+{
+	void (*draw)(void);
+	if((draw = MODE_FN(_mode, draw)))
+	{
+		draw();
+	}
+}
+
+/* Mode buttons and brightness, returns 0 for the buttons of the mode */
+static uint8_t key_global(uint8_t ev, uint8_t btn)
+{
+	uint8_t i;
+	if(btn == BTN_BRIGHTNESS_UP || btn == BTN_BRIGHTNESS_DOWN)
+	{
+		if(ev == KEY_PRESS || ev == KEY_REPEAT)
 		{
-			if(_ms >= ticks + _snake_update_ticks)
+			if(btn == BTN_BRIGHTNESS_UP)
 			{
-				ticks = _ms;
-				if(snake_update())
-				{
-					snake_init();
-				}
-
-				led_update();
+				led_brightness(_brightness > 255 - BRIGHTNESS_STEP ?
+					255 : _brightness + BRIGHTNESS_STEP);
 			}
-		}
-		else if(_mode == MODE_TETRIS)
-		{
-			if(_ms >= ticks + _tetris_update_ticks)
+			else
 			{
-				ticks = _ms;
-				piece_undraw();
-				++_piece.y;
-				if(!piece_valid())
-				{
-					if(_piece.y <= 0)
-					{
-						_tetris_update_ticks = FALL_SPEED_DEFAULT;
-						piece_next();
-						field_clear();
-					}
-					else
-					{
-						--_piece.y;
-						piece_to_field();
-						field_rows();
-						piece_next();
-					}
-				}
-
-				piece_draw();
-				led_update();
+				led_brightness(_brightness < BRIGHTNESS_STEP ?
+					0 : _brightness - BRIGHTNESS_STEP);
 			}
 		}
-	}
-
-	return 0;
-}
 
+		return 1;
+	}
 
-/* UART */
-int16_t uart_rx(void)
-{
-	if(!(UCSR0A & (1 << RXC0)))
+	for(i = 0; i < ARRLEN(_modes); ++i)
 	{
-		return -1;
+		if(pgm_read_byte(&_modes[i].btn) == btn)
+		{
+			if(ev == KEY_PRESS)
+			{
+				mode_set(i);
+			}
+
+			return 1;
+		}
 	}
 
-	return UDR0;
+	return 0;
 }
 
 
@@ -428,77 +607,140 @@ ISR(TIMER0_COMPA_vect)
 	++_ms;
 }
 
+/* _ms takes four loads, the interrupt must not change it in between */
+static uint32_t ms(void)
+{
+	uint8_t s = SREG;
+	uint32_t t;
+	cli();
+	t = _ms;
+	SREG = s;
+	return t;
+}
+
 
-/* RC5 */
-ISR(TIMER2_OVF_vect)
+/* Keys */
+/* Returns the next key event and its button, 0 if there is none */
+static uint8_t key_state(uint8_t *btn)
 {
-	static uint16_t rc5_tmp;
-	static uint8_t rc5_bit, rc5_time;
-	TCNT2 = -2;
+	key_event_t e;
+	uint32_t now;
+	uint8_t old;
 
-	if(++rc5_time > RC5_PULSE_MAX)
+	/* A press that followed the release of another button */
+	if(_key_pending)
 	{
-		if(!(rc5_tmp & 0x4000) && rc5_tmp & 0x2000)
-		{
-			rc5_data = rc5_tmp;
-		}
-
-		rc5_tmp = 0;
+		_key_pending = 0;
+		*btn = _key_btn;
+		return KEY_PRESS;
 	}
 
-	if((rc5_bit ^ RC5_IN) & (1 << RC5_PIN))
+	if(key_get(&e))
 	{
-		rc5_bit = ~rc5_bit;
-		if(rc5_time < RC5_PULSE_MIN)
+		if(e.code == _key_code)
 		{
-			rc5_tmp = 0;
+			_key_last = e.ms;
 		}
-
-		if(!rc5_tmp || rc5_time > RC5_PULSE_1_2)
+		else
 		{
-			if(!(rc5_tmp & 0x4000))
-			{
-				rc5_tmp <<= 1;
-			}
-
-			if(!(rc5_bit & (1 << RC5_PIN)))
+			old = _key_btn;
+			_key_pending = (_key_code != 0);
+			_key_code = e.code;
+			_key_btn = e.code & ~KEY_TOGGLE;
+			_key_last = _key_down = e.ms;
+			LATENCY_KEY(e.us);
+			_key_next = e.ms + KEY_REPEAT_DELAY;
+			_key_long = 0;
+
+			if(_key_pending)
 			{
-				rc5_tmp |= 1;
+				*btn = old;
+				return KEY_RELEASE;
 			}
 
-			rc5_time = 0;
+			*btn = _key_btn;
+			return KEY_PRESS;
 		}
 	}
+
+	if(!_key_code)
+	{
+		return 0;
+	}
+
+	*btn = _key_btn;
+	now = ms();
+	if(now - _key_last > KEY_RELEASE_MS)
+	{
+		_key_code = 0;
+		return KEY_RELEASE;
+	}
+
+	if(!_key_long && now - _key_down >= KEY_LONG_MS)
+	{
+		_key_long = 1;
+		return KEY_LONG;
+	}
+
+	if((int32_t)(now - _key_next) >= 0)
+	{
+		_key_next = now + KEY_REPEAT_RATE;
+		return KEY_REPEAT;
+	}
+
+	return 0;
 }
 
 
-/* Smiley */
-static void led_image(const uint8_t *i, color_t *fg, color_t *bg)
+#if defined(IRMP) && IRMP
+/* IRMP */
+ISR(TIMER2_COMPA_vect)
 {
-	uint8_t x, y;
-	led_clear(bg);
-	for(y = 0; y < LED_SIZE; ++y)
+	static uint8_t toggle;
+	IRMP_DATA d;
+	uint8_t btn;
+	irmp_ISR();
+	if(irmp_get_data(&d) && (btn = ir_button(&d)))
 	{
-		for(x = 0; x < 8; ++x)
+		if(!(d.flags & IRMP_FLAG_REPETITION))
 		{
-			if((pgm_read_byte(i + 2 * y) >> x) & 1)
-			{
-				led_pixel(y, x, fg);
-			}
+			toggle = !toggle;
+		}
 
-			if((pgm_read_byte(i + 2 * y + 1) >> x) & 1)
-			{
-				led_pixel(y, x + 8, fg);
-			}
+		key_put(btn | (toggle ? KEY_TOGGLE : 0));
+	}
+}
+
+static uint8_t ir_button(IRMP_DATA *d)
+{
+	const ir_key_t *k;
+	for(k = _ir_keys; k < _ir_keys + ARRLEN(_ir_keys); ++k)
+	{
+		if(pgm_read_byte(&k->protocol) == d->protocol &&
+			pgm_read_word(&k->command) == d->command)
+		{
+			return pgm_read_byte(&k->btn);
 		}
 	}
 
-	led_update();
+	return 0;
 }
+#endif
 
-static void img_value(uint8_t v)
+
+/* Smiley */
+static void led_image(const uint8_t *i, color_t *fg, color_t *bg)
+{
+	uint8_t x;
+	led_clear(bg);
+	for(x = 0; x < LED_SIZE; ++x, i += 2)
+	{
+		led_column(x, pgm_read_byte(i) | (pgm_read_byte(i + 1) << 8), fg);
+	}
+}
+
+static uint8_t img_index(uint8_t v)
 {
-	color_t fg;
 	uint8_t i, m = 0;
 	for(i = 0; i < IMG_COUNT; ++i)
 	{
@@ -510,24 +752,136 @@ static void img_value(uint8_t v)
 		m += IMG_RANGE;
 	}
 
-	if(i >= IMG_COUNT)
+	return (i < IMG_COUNT) ? i : IMG_COUNT - 1;
+}
+
+static void img_value(uint8_t v)
+{
+	color_t fg;
+	vote_color(v, &fg);
+	led_image(img + img_index(v) * IMG_BYTES, &fg, &black);
+}
+
+static void smiley_init(void)
+{
+	_smiley_face = IMG_COUNT;
+	smiley_draw();
+}
+
+/* Only a different face is drawn, its colour is taken from the average
+   at that time */
+static void smiley_draw(void)
+{
+	uint8_t v = vote_value();
+	if(img_index(v) != _smiley_face)
 	{
-		i = IMG_COUNT - 1;
+		_smiley_face = img_index(v);
+		img_value(v);
 	}
+}
 
-	fg.B = 0;
+/* Red for bad votes, over yellow to green for good ones */
+static void vote_color(uint8_t v, color_t *c)
+{
+	c->B = 0;
 	if(v < 128)
 	{
-		fg.R = 255;
-		fg.G = v;
+		c->R = 255;
+		c->G = v;
 	}
 	else
 	{
-		fg.R = 255 - v;
-		fg.G = 255;
+		c->R = 255 - v;
+		c->G = 255;
 	}
+}
 
-	led_image(img + i * IMG_BYTES, &fg, &black);
+/* The face is drawn once for all votes */
+static void votes_add(const uint8_t *v, uint8_t n)
+{
+	while(n--)
+	{
+		vote_add(*v++);
+	}
+
+	vote_update();
+	mode_draw();
+}
+
+
+/* Histogram */
+/* Bars are scaled to the highest one, which fills the column. A bar is
+   darker towards the bottom. */
+static void hist_draw(void)
+{
+	uint16_t sums[LED_SIZE], max = 0;
+	uint8_t x, y, h, i;
+	const uint8_t *b = _vote_bins;
+	color_t top, c;
+
+	for(x = 0; x < LED_SIZE; ++x)
+	{
+		sums[x] = 0;
+		for(i = 0; i < HIST_BINS; ++i)
+		{
+			sums[x] += *b++;
+		}
+
+		if(sums[x] > max)
+		{
+			max = sums[x];
+		}
+	}
+
+	for(x = 0; x < LED_SIZE; ++x)
+	{
+		h = max ? ((uint32_t)sums[x] * LED_SIZE + max - 1) / max : 0;
+		if(h == _hist_heights[x])
+		{
+			continue;
+		}
+
+#if defined(LED_PALETTE) && LED_PALETTE
+		vote_color(img_index(x * HIST_BINS) * IMG_RANGE + IMG_RANGE / 2, &top);
+#else
+		vote_color(x * HIST_BINS + HIST_BINS / 2, &top);
+#endif
+		for(y = 0; y < LED_SIZE; ++y)
+		{
+			/* Row y from the bottom, only cells that change */
+			if((y < h) == (y < _hist_heights[x]))
+			{
+				continue;
+			}
+
+			if(y < h)
+			{
+				i = 96 + y * HIST_SHADES / LED_SIZE * HIST_STEP;
+				c.R = LED_SCALE(top.R, i);
+				c.G = LED_SCALE(top.G, i);
+				c.B = LED_SCALE(top.B, i);
+				led_pixel(x, LED_SIZE - 1 - y, &c);
+			}
+			else
+			{
+				led_pixel(x, LED_SIZE - 1 - y, &black);
+			}
+		}
+
+		_hist_heights[x] = h;
+	}
+}
+
+static void hist_init(void)
+{
+	uint8_t x;
+	led_clear(&black);
+	for(x = 0; x < LED_SIZE; ++x)
+	{
+		_hist_heights[x] = 0;
+	}
+
+	hist_draw();
 }
 
 
@@ -593,6 +947,43 @@ static void snake_init(void)
 	draw_food();
 }
 
+static void snake_input(uint8_t ev, uint8_t btn)
+{
+	if(ev != KEY_PRESS)
+	{
+		return;
+	}
+
+	switch(btn)
+	{
+	case BTN_UP_PRESSED:
+		_dir = UP;
+		break;
+
+	case BTN_RIGHT_PRESSED:
+		_dir = RIGHT;
+		break;
+
+	case BTN_DOWN_PRESSED:
+		_dir = DOWN;
+		break;
+
+	case BTN_LEFT_PRESSED:
+		_dir = LEFT;
+		break;
+	}
+}
+
+static uint16_t snake_tick(void)
+{
+	if(snake_update())
+	{
+		snake_init();
+	}
+
+	return _snake_update_ticks;
+}
+
 static uint8_t snake_update(void)
 {
 	if(_dir)
@@ -690,6 +1081,77 @@ static void snake_advance(void)
 
 
 /* Tetris */
+static void tetris_init(void)
+{
+	_tetris_update_ticks = FALL_SPEED_DEFAULT;
+	_soft_drop = 0;
+	field_clear();
+	piece_next();
+}
+
+/* LEFT and RIGHT repeat while held, DROP falls fast until released */
+static void tetris_input(uint8_t ev, uint8_t btn)
+{
+	if(btn == BTN_DROP_PRESSED && ev != KEY_REPEAT)
+	{
+		_soft_drop = (ev == KEY_PRESS);
+		mode_period(_soft_drop ? FALL_SPEED_SOFT : _tetris_update_ticks);
+		return;
+	}
+
+	if(ev != KEY_PRESS && (ev != KEY_REPEAT ||
+		(btn != BTN_LEFT_PRESSED && btn != BTN_RIGHT_PRESSED)))
+	{
+		return;
+	}
+
+	piece_undraw();
+	switch(btn)
+	{
+	case BTN_UP_PRESSED:
+		piece_rotate_right();
+		break;
+
+	case BTN_RIGHT_PRESSED:
+		piece_move_right();
+		break;
+
+	case BTN_DOWN_PRESSED:
+		piece_rotate_left();
+		break;
+
+	case BTN_LEFT_PRESSED:
+		piece_move_left();
+		break;
+	}
+
+	piece_draw();
+}
+
+static uint16_t tetris_tick(void)
+{
+	piece_undraw();
+	++_piece.y;
+	if(!piece_valid())
+	{
+		if(_piece.y <= 0)
+		{
+			/* Game over */
+			tetris_init();
+		}
+		else
+		{
+			--_piece.y;
+			piece_to_field();
+			field_rows();
+			piece_next();
+		}
+	}
+
+	piece_draw();
+	return _soft_drop ? FALL_SPEED_SOFT : _tetris_update_ticks;
+}
+
 static void piece_undraw(void)
 {
 	int8_t row, col;
@@ -897,7 +1359,6 @@ static void field_clear(void)
 	}
 
 	led_clear(&black);
-	led_update();
 }
 
 static void field_rows(void)
@@ -932,9 +1393,9 @@ static void field_rows(void)
 	/* Redraw */
 	if(v)
 	{
-		led_clear(&black);
 		for(y = 0; y < LED_SIZE; ++y)
 		{
+			uint16_t empty = 0;
 			for(x = 0; x < LED_SIZE; ++x)
 			{
 				if((v = _field[y * LED_SIZE + x]))
@@ -942,7 +1403,13 @@ static void field_rows(void)
 					--v;
 					led_pixel(x, y, &_pieces[v].color);
 				}
+				else
+				{
+					empty |= (1U << x);
+				}
 			}
+
+			led_row(y, empty, &black);
 		}
 	}
 }
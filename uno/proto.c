@@ -0,0 +1,370 @@
+/* Binary serial protocol, enabled with PROTO. Packets are told apart from
+   the text commands by the sync byte, which never starts a text line:
+
+     0xA5, length (2 bytes), type, payload (length bytes), CRC (2 bytes)
+
+   Multi-byte fields are little endian. The CRC is CRC-16/MCRF4XX
+   (_crc_ccitt_update, start value 0xFFFF) over length, type and payload.
+   Every packet is answered with PROTO_ACK or PROTO_NAK. A frame takes
+   longer to show than the receive ring can buffer, so the sender has to
+   wait for the answer before it sends the next packet.
+
+     PROTO_VOTE   1..PROTO_VOTES bytes, one vote each
+     PROTO_PIXEL  n * (index, R, G, B), index is y * LED_SIZE + x
+     PROTO_FRAME  LED_PIXELS * (R, G, B), row by row from the top left
+     PROTO_MODE   1 byte, see MODE_*
+     PROTO_RLE    frame in runs, see below
+     PROTO_DELTA  runs XORed into the shown frame
+
+   RLE and delta frames are a list of runs over the pixels in the order
+   of PROTO_FRAME, starting at the top left. A run starts with a byte n:
+   if bit 7 is set, one (R, G, B) follows for (n & 0x7F) + 1 pixels,
+   otherwise (n + 1) pixels follow with an (R, G, B) each. A delta frame
+   XORs the colours into the framebuffer, unchanged pixels are a run of
+   zeros and cost no time. Frames may end early. The host side encoder is
+   stream.c. With LED_PALETTE the framebuffer only holds the nearest
+   colour, send a full frame from time to time.
+
+   Pixels go into the framebuffer as they arrive, there is no RAM for a
+   second one. Until the CRC is found correct PROTO_HOLD() keeps
+   frame_present() from sending the frame, the ACK follows once it was
+   sent. After a broken header the input is ignored until it was silent
+   for PROTO_TIMEOUT ms. */
+#if defined(PROTO) && PROTO
+#include <util/crc16.h>
+
+#define PROTO_SYNC         0xA5
+#define PROTO_ACK          0x06
+#define PROTO_NAK          0x15
+#define PROTO_TIMEOUT        20
+#define PROTO_VOTES          16
+
+#define PROTO_VOTE            1
+#define PROTO_PIXEL           2
+#define PROTO_FRAME           3
+#define PROTO_MODE            4
+#define PROTO_RLE             5
+#define PROTO_DELTA           6
+
+#define PROTO_RUN          0x80
+
+enum
+{
+	PROTO_IDLE,
+	PROTO_LEN_LO,
+	PROTO_LEN_HI,
+	PROTO_TYPE,
+	PROTO_DATA,
+	PROTO_CRC_LO,
+	PROTO_CRC_HI,
+	PROTO_SKIP
+};
+
+static uint8_t _proto_state, _proto_type, _proto_n;
+static uint8_t _proto_run, _proto_fill;
+static uint16_t _proto_len, _proto_pos, _proto_crc, _proto_check;
+static uint16_t _proto_pixel;
+static uint8_t _proto_buf[PROTO_VOTES];
+static uint32_t _proto_last;
+static uint8_t _proto_errors;
+
+/* The framebuffer holds part of a frame, main() must not send it */
+static uint8_t _proto_hold, _proto_ack;
+
+#define PROTO_HOLD()          _proto_hold
+#define PROTO_SHOWN()         proto_shown()
+
+static int16_t proto_line(char *buf, uint8_t size);
+static void proto_byte(uint8_t c);
+static uint8_t proto_header(void);
+static void proto_data(uint8_t c);
+static void proto_runs(uint8_t c);
+static void proto_put(color_t *c);
+static void proto_done(void);
+static void proto_error(void);
+static void proto_shown(void);
+
+/* Feeds received bytes to the packet decoder and text to the line
+   assembler, returns like uart_line() */
+static int16_t proto_line(char *buf, uint8_t size)
+{
+	int16_t c, n;
+	if(_proto_state != PROTO_IDLE && ms() - _proto_last > PROTO_TIMEOUT)
+	{
+		if(_proto_state != PROTO_SKIP)
+		{
+			proto_error();
+		}
+
+		_proto_state = PROTO_IDLE;
+	}
+
+	while((c = uart_rx()) >= 0)
+	{
+		_proto_last = ms();
+		if(_proto_state == PROTO_IDLE && c != PROTO_SYNC)
+		{
+			if((n = uart_line_put(buf, size, c)) >= 0)
+			{
+				return n;
+			}
+
+			continue;
+		}
+
+		proto_byte(c);
+	}
+
+	return -1;
+}
+
+static void proto_byte(uint8_t c)
+{
+	switch(_proto_state)
+	{
+	case PROTO_IDLE:
+		_proto_crc = 0xFFFF;
+		_proto_state = PROTO_LEN_LO;
+		return;
+
+	case PROTO_LEN_LO:
+		_proto_len = c;
+		break;
+
+	case PROTO_LEN_HI:
+		_proto_len |= (uint16_t)c << 8;
+		break;
+
+	case PROTO_TYPE:
+		_proto_type = c;
+		_proto_crc = _crc_ccitt_update(_proto_crc, c);
+		if(!proto_header())
+		{
+			proto_error();
+			_proto_state = PROTO_SKIP;
+			return;
+		}
+
+		_proto_pos = 0;
+		_proto_n = 0;
+		_proto_run = 0;
+		_proto_pixel = 0;
+		_proto_hold |= (_proto_type != PROTO_VOTE &&
+			_proto_type != PROTO_MODE);
+		++_proto_state;
+		return;
+
+	case PROTO_DATA:
+		proto_data(c);
+		if(++_proto_pos == _proto_len)
+		{
+			++_proto_state;
+		}
+
+		return;
+
+	case PROTO_CRC_LO:
+		_proto_check = c;
+		++_proto_state;
+		return;
+
+	case PROTO_CRC_HI:
+		_proto_check |= (uint16_t)c << 8;
+		_proto_state = PROTO_IDLE;
+		if(_proto_check != _proto_crc)
+		{
+			proto_error();
+			return;
+		}
+
+		proto_done();
+		return;
+
+	default:
+		return;
+	}
+
+	_proto_crc = _crc_ccitt_update(_proto_crc, c);
+	++_proto_state;
+}
+
+/* Checks the length of the packet type */
+static uint8_t proto_header(void)
+{
+	switch(_proto_type)
+	{
+	case PROTO_VOTE:
+		return _proto_len > 0 && _proto_len <= PROTO_VOTES;
+
+	case PROTO_PIXEL:
+		return _proto_len > 0 && !(_proto_len & 3) &&
+			_proto_len <= LED_PIXELS * 4;
+
+	case PROTO_FRAME:
+		return _proto_len == LED_PIXELS * 3;
+
+	case PROTO_MODE:
+		return _proto_len == 1;
+
+	case PROTO_RLE:
+	case PROTO_DELTA:
+		return _proto_len > 0 && _proto_len <= LED_PIXELS * 4;
+	}
+
+	return 0;
+}
+
+static void proto_data(uint8_t c)
+{
+	color_t p;
+	_proto_crc = _crc_ccitt_update(_proto_crc, c);
+	if(_proto_type == PROTO_RLE || _proto_type == PROTO_DELTA)
+	{
+		proto_runs(c);
+	}
+	else if(_proto_type == PROTO_FRAME || _proto_type == PROTO_PIXEL)
+	{
+		/* A pixel write starts with the index, a frame counts */
+		if(_proto_type == PROTO_PIXEL && !(_proto_pos & 3))
+		{
+			_proto_pixel = c;
+			return;
+		}
+
+		_proto_buf[_proto_n++] = c;
+		if(_proto_n == 3)
+		{
+			p.R = _proto_buf[0];
+			p.G = _proto_buf[1];
+			p.B = _proto_buf[2];
+			proto_put(&p);
+			_proto_n = 0;
+		}
+	}
+	else
+	{
+		_proto_buf[_proto_pos] = c;
+	}
+}
+
+/* Runs of RLE and delta frames */
+static void proto_runs(uint8_t c)
+{
+	color_t p;
+	if(!_proto_run)
+	{
+		_proto_fill = c & PROTO_RUN;
+		_proto_run = (c & ~PROTO_RUN) + 1;
+		_proto_n = 0;
+		return;
+	}
+
+	_proto_buf[_proto_n++] = c;
+	if(_proto_n < 3)
+	{
+		return;
+	}
+
+	_proto_n = 0;
+	p.R = _proto_buf[0];
+	p.G = _proto_buf[1];
+	p.B = _proto_buf[2];
+	if(!_proto_fill)
+	{
+		proto_put(&p);
+		--_proto_run;
+		return;
+	}
+
+	/* Nothing changes along a run of zeros in a delta frame */
+	if(_proto_type == PROTO_DELTA && !(p.R | p.G | p.B))
+	{
+		_proto_pixel += _proto_run;
+	}
+	else
+	{
+		for(; _proto_run; --_proto_run)
+		{
+			proto_put(&p);
+		}
+	}
+
+	_proto_run = 0;
+}
+
+/* Writes the next pixel, delta frames XOR it into the framebuffer */
+static void proto_put(color_t *c)
+{
+	color_t o;
+	uint8_t i;
+	if(_proto_pixel < LED_PIXELS)
+	{
+		i = pgm_read_byte(&_led_map[_proto_pixel / LED_SIZE]
+			[_proto_pixel % LED_SIZE]);
+
+		if(_proto_type == PROTO_DELTA)
+		{
+			led_get(i, &o);
+			o.R ^= c->R;
+			o.G ^= c->G;
+			o.B ^= c->B;
+			c = &o;
+		}
+
+		led_set(i, c);
+	}
+
+	++_proto_pixel;
+}
+
+static void proto_done(void)
+{
+	switch(_proto_type)
+	{
+	case PROTO_VOTE:
+		votes_add(_proto_buf, _proto_len);
+		break;
+
+	case PROTO_PIXEL:
+	case PROTO_FRAME:
+	case PROTO_RLE:
+	case PROTO_DELTA:
+		/* Answered by proto_shown() */
+		_proto_hold = 0;
+		_proto_ack = 1;
+		return;
+
+	case PROTO_MODE:
+		mode_set(_proto_buf[0]);
+		break;
+	}
+
+	uart_tx(PROTO_ACK);
+}
+
+/* A broken packet releases the framebuffer, the sender answers the NAK
+   with a key frame */
+static void proto_error(void)
+{
+	if(_proto_errors < 255)
+	{
+		++_proto_errors;
+	}
+
+	_proto_hold = 0;
+	uart_tx(PROTO_NAK);
+}
+
+/* Called by main() after the framebuffer was sent */
+static void proto_shown(void)
+{
+	if(_proto_ack)
+	{
+		_proto_ack = 0;
+		uart_tx(PROTO_ACK);
+	}
+}
+#else
+#define PROTO_HOLD()          0
+#define PROTO_SHOWN()
+#endif
@@ -0,0 +1,164 @@
+/* RC5 decoder and key event queue, shared by uno and uno_tester.
+
+   The decoder only runs on edges of the IR input (pin change interrupt)
+   and times them with Timer2, which runs free at F_CPU / RC5_PRESCALER.
+   A compare match one maximum pulse length after the last bit ends the
+   frame. Decoded buttons are queued with the time from _ms, which the
+   including file has to provide. With IRMP only the queue is used. */
+#ifndef RC5_IN
+#define RC5_IN                PIND
+#define RC5_PIN              7
+#define RC5_PCMSK             PCMSK2
+#define RC5_PCIE              PCIE2
+#endif
+
+#ifndef RC5_PRESCALER
+#define RC5_PRESCALER       256
+#endif
+
+#if (RC5_PRESCALER == 128)
+#define RC5_CS                ((1 << CS22) | (1 << CS20))
+#elif (RC5_PRESCALER == 256)
+#define RC5_CS                ((1 << CS22) | (1 << CS21))
+#elif (RC5_PRESCALER == 1024)
+#define RC5_CS                ((1 << CS22) | (1 << CS21) | (1 << CS20))
+#else
+#error "RC5_PRESCALER has to be 128, 256 or 1024"
+#endif
+
+#if (F_CPU / RC5_PRESCALER * 2400 / 1000000 > 255)
+#error "RC5_PRESCALER too low for F_CPU"
+#elif (F_CPU / RC5_PRESCALER * 533 / 1000000 < 8)
+#error "RC5_PRESCALER too high for F_CPU"
+#endif
+
+#define RC5_TIME      1.778e-3 /* 1.778 _ms */
+#define RC5_TICKS(f)          (uint8_t)(F_CPU / RC5_PRESCALER * RC5_TIME * (f) + 0.5)
+/* Edges are sampled once per bit: a half bit edge has to stay below
+   RC5_PULSE_1_2 and the next mid-bit edge above it, with up to +-15 %
+   remote clock skew and +-100 us edge jitter at the same time */
+#define RC5_PULSE_MIN         RC5_TICKS(0.3)
+#define RC5_PULSE_1_2         RC5_TICKS(0.72)
+#define RC5_PULSE_MAX         RC5_TICKS(1.35)
+
+#define RC5_TOGGLE       0x0800
+#define RC5_BUTTON(c)         (((c) & 0x3F) | (~(c) >> 7 & 0x40))
+#define RC5_KEY(c) \
+	(RC5_BUTTON(c) | (((c) & RC5_TOGGLE) ? KEY_TOGGLE : 0))
+
+/* Keys: filled by the IR interrupt, read by the main loop. Only the
+   interrupt writes the head and only main() the tail, so no locking is
+   needed. Events that do not fit are counted in _key_overflow. The code
+   is the button, KEY_TOGGLE flips with every new press. */
+#define KEY_QUEUE_SIZE        8
+#define KEY_TOGGLE       0x8000
+#define KEY_QUEUE_MASK        (KEY_QUEUE_SIZE - 1)
+
+typedef struct KEY_EVENT
+{
+	uint16_t code;
+	uint32_t ms;
+#if defined(LATENCY) && LATENCY
+	uint16_t us;
+#endif
+} key_event_t;
+
+static volatile key_event_t _keys[KEY_QUEUE_SIZE];
+static volatile uint8_t _key_head, _key_tail;
+static volatile uint8_t _key_overflow;
+
+#if !(defined(IRMP) && IRMP)
+static uint16_t rc5_tmp;
+static uint8_t rc5_time;
+
+static void rc5_init(void);
+#endif
+static void key_put(uint16_t code);
+static uint8_t key_get(key_event_t *e);
+
+#if !(defined(IRMP) && IRMP)
+static void rc5_init(void)
+{
+	TCCR2B = RC5_CS;
+	RC5_PCMSK = (1 << RC5_PIN);
+	PCICR = (1 << RC5_PCIE);
+}
+
+ISR(PCINT2_vect)
+{
+	uint8_t now = TCNT2;
+	uint8_t t = now - rc5_time;
+	if(t < RC5_PULSE_MIN)
+	{
+		rc5_tmp = 0;
+	}
+
+	if(!rc5_tmp || t > RC5_PULSE_1_2)
+	{
+		if(!(rc5_tmp & 0x4000))
+		{
+			rc5_tmp <<= 1;
+		}
+
+		if(!(RC5_IN & (1 << RC5_PIN)))
+		{
+			rc5_tmp |= 1;
+		}
+
+		rc5_time = now;
+		OCR2A = now + RC5_PULSE_MAX;
+		TIFR2 = (1 << OCF2A);
+		TIMSK2 = (1 << OCIE2A);
+	}
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+	TIMSK2 = 0;
+	if(!(rc5_tmp & 0x4000) && rc5_tmp & 0x2000)
+	{
+		key_put(RC5_KEY(rc5_tmp));
+	}
+
+	rc5_tmp = 0;
+}
+#endif
+
+static void key_put(uint16_t code)
+{
+	uint8_t head = _key_head;
+	uint8_t next = (head + 1) & KEY_QUEUE_MASK;
+	if(next == _key_tail)
+	{
+		if(_key_overflow < 255)
+		{
+			++_key_overflow;
+		}
+
+		return;
+	}
+
+	_keys[head].code = code;
+	_keys[head].ms = _ms;
+#if defined(LATENCY) && LATENCY
+	_keys[head].us = latency_us();
+#endif
+	_key_head = next;
+}
+
+static uint8_t key_get(key_event_t *e)
+{
+	uint8_t tail = _key_tail;
+	if(tail == _key_head)
+	{
+		return 0;
+	}
+
+	e->code = _keys[tail].code;
+	e->ms = _keys[tail].ms;
+#if defined(LATENCY) && LATENCY
+	e->us = _keys[tail].us;
+#endif
+	_key_tail = (tail + 1) & KEY_QUEUE_MASK;
+	return 1;
+}
@@ -0,0 +1,243 @@
+/* Host test bench of the RC5 decoder, built with "make rc5bench". RC5
+   frames are generated by irsnd (ANALYZE build, see remote/irsnd.c), the
+   samples are distorted and the edges are fed to the decoder interrupts
+   with a simulated Timer2. Usage:
+
+     ./rc5bench [-n frames] [-j jitter_us] [-p noise] [-s skew_percent]
+                [-r seed] [-i irsnd]
+
+   jitter moves every edge by up to +-jitter_us, noise is the probability
+   of a single sample being flipped, skew stretches the timing of the
+   remote. The decode rate and the decoder cost per input sample are
+   printed, cycles are those of the host. */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static volatile uint32_t _ms;
+
+#include "rc5.c"
+
+#define BENCH_PROTOCOL        7 /* IRMP_RC5_PROTOCOL */
+#define BENCH_F_SAMPLE    20000 /* F_INTERRUPTS of irsnd */
+#define BENCH_IDLE_US    100000
+#define BENCH_SAMPLES      4096
+
+#define US_TICKS(t)           ((t) * (F_CPU / 256) / 1000000.0)
+
+static double _jitter, _noise, _skew;
+static uint32_t _seed = 1;
+static const char *_irsnd = "./irsnd-analyze";
+
+static uint32_t _tick;
+static uint32_t _compare;
+static uint32_t _isr_calls;
+static uint64_t _isr_cycles;
+
+static double bench_random(void);
+static uint16_t bench_frame(uint8_t command, char *samples);
+static void bench_time(uint32_t tick);
+static void bench_edge(uint32_t tick, uint8_t level);
+static uint64_t bench_cycles(void);
+
+int main(int argc, char **argv)
+{
+	static char samples[BENCH_SAMPLES];
+	uint32_t frames = 1000, ok = 0, wrong = 0, count = 0, n, k, start;
+	uint16_t len;
+	uint8_t level, command;
+	double us, t;
+	key_event_t e;
+	int c;
+
+	while((c = getopt(argc, argv, "n:j:p:s:r:i:")) != -1)
+	{
+		switch(c)
+		{
+		case 'n':
+			frames = atol(optarg);
+			break;
+
+		case 'j':
+			_jitter = atof(optarg);
+			break;
+
+		case 'p':
+			_noise = atof(optarg);
+			break;
+
+		case 's':
+			_skew = atof(optarg);
+			break;
+
+		case 'r':
+			_seed = atol(optarg);
+			break;
+
+		case 'i':
+			_irsnd = optarg;
+			break;
+
+		default:
+			fprintf(stderr, "usage: %s [-n frames] [-j jitter_us] "
+				"[-p noise] [-s skew_percent] [-r seed] [-i irsnd]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	rc5_init();
+	us = 1e6 / BENCH_F_SAMPLE * (1 + _skew / 100);
+	for(n = 0; n < frames; ++n)
+	{
+		command = n & 0x3F;
+		if(!(len = bench_frame(command, samples)))
+		{
+			return 1;
+		}
+
+		/* The line idles high, irsnd prints 0 for carrier (low) */
+		start = _tick;
+		t = start * 1e6 / (F_CPU / 256);
+		level = 1;
+		for(k = 0; k < len; ++k)
+		{
+			c = samples[k] - '0';
+			if(bench_random() < _noise)
+			{
+				c = !c;
+			}
+
+			if(c != level)
+			{
+				level = c;
+				bench_edge(start + US_TICKS(k * us +
+					(bench_random() * 2 - 1) * _jitter) + 0.5, level);
+			}
+		}
+
+		if(!level)
+		{
+			bench_edge(start + US_TICKS(len * us) + 0.5, 1);
+		}
+
+		bench_time(US_TICKS(t + len * us + BENCH_IDLE_US));
+		count += len;
+
+		if(key_get(&e))
+		{
+			if((e.code & ~KEY_TOGGLE) == command && !key_get(&e))
+			{
+				++ok;
+			}
+			else
+			{
+				++wrong;
+			}
+
+			while(key_get(&e)) ;
+		}
+	}
+
+	printf("frames %lu, decoded %lu (%.1f%%), wrong %lu, missed %lu\n",
+		(unsigned long)frames, (unsigned long)ok, ok * 100.0 / frames,
+		(unsigned long)wrong, (unsigned long)(frames - ok - wrong));
+
+	printf("%.2f interrupts per frame, %.4f per sample, "
+		"%.2f cycles per sample\n",
+		(double)_isr_calls / frames, (double)_isr_calls / count,
+		(double)_isr_cycles / count);
+
+	return 0;
+}
+
+/* Samples of one frame from irsnd, '0' and '1' */
+static uint16_t bench_frame(uint8_t command, char *samples)
+{
+	char cmd[256];
+	size_t len;
+	FILE *f;
+
+	snprintf(cmd, sizeof(cmd), "%s %d 0 %x", _irsnd, BENCH_PROTOCOL,
+		command);
+	if(!(f = popen(cmd, "r")))
+	{
+		perror(_irsnd);
+		return 0;
+	}
+
+	len = fread(samples, 1, BENCH_SAMPLES, f);
+	if(pclose(f) || !len)
+	{
+		fprintf(stderr, "%s failed\n", cmd);
+		return 0;
+	}
+
+	return len;
+}
+
+/* Runs Timer2 up to tick, the compare match fires on the way */
+static void bench_time(uint32_t tick)
+{
+	uint64_t c;
+	if((TIMSK2 & (1 << OCIE2A)) && _compare <= tick)
+	{
+		_tick = _compare;
+		TCNT2 = _tick;
+		c = bench_cycles();
+		TIMER2_COMPA_vect();
+		_isr_cycles += bench_cycles() - c;
+		++_isr_calls;
+	}
+
+	_tick = tick;
+	TCNT2 = _tick;
+}
+
+static void bench_edge(uint32_t tick, uint8_t level)
+{
+	uint64_t c;
+	if(tick < _tick)
+	{
+		tick = _tick;
+	}
+
+	bench_time(tick);
+	PIND = level ? (1 << RC5_PIN) : 0;
+
+	c = bench_cycles();
+	PCINT2_vect();
+	_isr_cycles += bench_cycles() - c;
+	++_isr_calls;
+
+	if(TIMSK2 & (1 << OCIE2A))
+	{
+		_compare = _tick + (uint8_t)(OCR2A - TCNT2);
+	}
+}
+
+/* xorshift32, reproducible for a given seed */
+static double bench_random(void)
+{
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 17;
+	_seed ^= _seed << 5;
+	return _seed / 4294967296.0;
+}
+
+static uint64_t bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000ULL + t.tv_nsec;
+#endif
+}
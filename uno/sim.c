@@ -0,0 +1,372 @@
+/* Host build of the firmware for headless testing, built with "make sim".
+   Every frame sent by led_update() is rendered to PPM files or to an ANSI
+   true colour terminal. The firmware is driven by a script read from a
+   file or stdin, one command per line:
+
+     key <n>       remote button n (see BTN_*)
+     hold <n> <ms> button n held down, repeated like a TV remote does
+     uart <text>   line received on the UART, e.g. a vote "80" or "I40"
+     votes <a> <b> <n>
+                   n rounds of one vote for each value a..b, drawn once
+     wait <ms>     let the firmware run for some time
+     quit
+
+   Full histogram bins, e.g. for bars summing more than 16 bit:
+
+     key 9
+     votes 0 255 200
+     votes 0 15 50
+     wait 100
+
+   Time is simulated: every pass of the main loop is one millisecond, so
+   the output only depends on the script. Usage:
+
+     ./sim [-p prefix] [-t] [-r] [-q] [script] */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static char *itoa(int v, char *s, int radix);
+static char *ultoa(unsigned long v, char *s, int radix);
+#define utoa(v, s, radix)     ultoa(v, s, radix)
+void uart_tx(char c);
+
+#define main firmware_main
+#include "main.c"
+#undef main
+
+#define KEY_CODE(n, t)        ((n) | ((t) ? KEY_TOGGLE : 0))
+#define RC5_REPEAT_MS       114
+
+static FILE *_script;
+static const char *_ppm;
+static uint8_t _ansi, _realtime, _quiet;
+
+static uint32_t _wait;
+static uint8_t _toggle;
+static uint16_t _hold;
+static uint32_t _hold_end, _hold_next;
+static char _line[64];
+static const char *_rx;
+
+static uint32_t _frames;
+static struct timespec _start;
+
+static void host_command(void);
+static void host_votes(char *arg);
+static void host_exit(void);
+static double host_seconds(void);
+static void host_ppm(color_t *strip);
+static void host_ansi(color_t *strip);
+
+int main(int argc, char **argv)
+{
+	int c;
+	_script = stdin;
+	while((c = getopt(argc, argv, "p:trq")) != -1)
+	{
+		switch(c)
+		{
+		case 'p':
+			_ppm = optarg;
+			break;
+
+		case 't':
+			_ansi = 1;
+			break;
+
+		case 'r':
+			_realtime = 1;
+			break;
+
+		case 'q':
+			_quiet = 1;
+			break;
+
+		default:
+			fprintf(stderr,
+				"usage: %s [-p prefix] [-t] [-r] [-q] [script]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if(optind < argc && !(_script = fopen(argv[optind], "r")))
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &_start);
+	return firmware_main();
+}
+
+/* Called once per pass of the main loop */
+int16_t uart_rx(void)
+{
+	if(_rx)
+	{
+		if(*_rx)
+		{
+			return *_rx++;
+		}
+
+		_rx = NULL;
+		return '\n';
+	}
+
+	while(!_wait)
+	{
+		host_command();
+	}
+
+	if(_realtime)
+	{
+		usleep(1000);
+	}
+
+	if(_hold && _ms >= _hold_next)
+	{
+		if(_ms >= _hold_end)
+		{
+			_hold = 0;
+		}
+		else
+		{
+			key_put(_hold);
+			_hold_next += RC5_REPEAT_MS;
+		}
+	}
+
+	--_wait;
+	TIMER0_COMPA_vect();
+	return -1;
+}
+
+void uart_tx(char c)
+{
+	if(!_quiet)
+	{
+		fputc(c, stderr);
+	}
+}
+
+void host_show(color_t *strip, uint16_t count)
+{
+	++_frames;
+	if(_ppm)
+	{
+		host_ppm(strip);
+	}
+
+	if(_ansi)
+	{
+		host_ansi(strip);
+	}
+}
+
+static void host_command(void)
+{
+	char *arg, *end;
+	if(!fgets(_line, sizeof(_line), _script))
+	{
+		host_exit();
+	}
+
+	_line[strcspn(_line, "\r\n")] = '\0';
+	if((arg = strchr(_line, ' ')))
+	{
+		*arg++ = '\0';
+	}
+
+	if(!_line[0] || _line[0] == '#')
+	{
+		return;
+	}
+
+	if(!strcmp(_line, "key") && arg)
+	{
+		_toggle = !_toggle;
+		key_put(KEY_CODE(atoi(arg), _toggle));
+		_wait = 1;
+	}
+	else if(!strcmp(_line, "hold") && arg)
+	{
+		_toggle = !_toggle;
+		_hold = KEY_CODE(strtol(arg, &end, 10), _toggle);
+		_wait = strtol(end, NULL, 10);
+		_hold_next = _ms;
+		_hold_end = _ms + _wait;
+	}
+	else if(!strcmp(_line, "uart") && arg)
+	{
+		_rx = arg;
+		_wait = 1;
+	}
+	else if(!strcmp(_line, "votes") && arg)
+	{
+		host_votes(arg);
+		_wait = 1;
+	}
+	else if(!strcmp(_line, "wait") && arg)
+	{
+		_wait = atol(arg);
+	}
+	else if(!strcmp(_line, "quit"))
+	{
+		host_exit();
+	}
+	else
+	{
+		fprintf(stderr, "unknown command: %s\n", _line);
+	}
+}
+
+/* Like votes_add(), without its limit of 255 votes */
+static void host_votes(char *arg)
+{
+	long a, b, n, v;
+	a = strtol(arg, &arg, 10);
+	b = strtol(arg, &arg, 10);
+	for(n = strtol(arg, NULL, 10); n > 0; --n)
+	{
+		for(v = a; v <= b && v < 256; ++v)
+		{
+			vote_add(v);
+		}
+	}
+
+	vote_update();
+	mode_draw();
+}
+
+static void host_exit(void)
+{
+	double s = host_seconds();
+	fprintf(stderr, "%lu frames in %lu ms (%.1f fps), %.3f s host time",
+		(unsigned long)_frames, (unsigned long)_ms,
+		_ms ? _frames * 1000.0 / _ms : 0.0, s);
+
+	if(s > 0)
+	{
+		fprintf(stderr, " (%.0f fps)", _frames / s);
+	}
+
+	fputc('\n', stderr);
+	exit(0);
+}
+
+static double host_seconds(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec - _start.tv_sec) + (t.tv_nsec - _start.tv_nsec) / 1e9;
+}
+
+/* One file per frame, the frame number and time go into a comment */
+static void host_ppm(color_t *strip)
+{
+	char name[256];
+	uint8_t x, y;
+	color_t *c;
+	FILE *f;
+
+	snprintf(name, sizeof(name), "%s%05lu.ppm", _ppm,
+		(unsigned long)_frames);
+
+	if(!(f = fopen(name, "wb")))
+	{
+		perror(name);
+		return;
+	}
+
+	fprintf(f, "P6\n# frame %lu, %lu ms\n%d %d\n255\n",
+		(unsigned long)_frames, (unsigned long)_ms, LED_SIZE, LED_SIZE);
+
+	for(y = 0; y < LED_SIZE; ++y)
+	{
+		for(x = 0; x < LED_SIZE; ++x)
+		{
+			c = &strip[pgm_read_byte(&_led_map[y][x])];
+			fputc(c->R, f);
+			fputc(c->G, f);
+			fputc(c->B, f);
+		}
+	}
+
+	fclose(f);
+}
+
+/* Two rows per line, upper half block in the foreground colour */
+static void host_ansi(color_t *strip)
+{
+	uint8_t x, y;
+	color_t *t, *b;
+
+	printf("frame %lu, %lu ms\n", (unsigned long)_frames,
+		(unsigned long)_ms);
+
+	for(y = 0; y < LED_SIZE; y += 2)
+	{
+		for(x = 0; x < LED_SIZE; ++x)
+		{
+			t = &strip[pgm_read_byte(&_led_map[y][x])];
+			b = &strip[pgm_read_byte(&_led_map[y + 1][x])];
+			printf("\033[38;2;%d;%d;%dm\033[48;2;%d;%d;%dm\xe2\x96\x80",
+				t->R, t->G, t->B, b->R, b->G, b->B);
+		}
+
+		printf("\033[0m\n");
+	}
+
+	fflush(stdout);
+}
+
+static char *itoa(int v, char *s, int radix)
+{
+	char *p = s, *q, t;
+	unsigned u = (v < 0 && radix == 10) ? -v : v;
+	do
+	{
+		*p++ = "0123456789abcdefghijklmnopqrstuvwxyz"[u % radix];
+		u /= radix;
+	}
+	while(u);
+
+	if(v < 0 && radix == 10)
+	{
+		*p++ = '-';
+	}
+
+	*p = '\0';
+	for(q = s, --p; q < p; ++q, --p)
+	{
+		t = *q;
+		*q = *p;
+		*p = t;
+	}
+
+	return s;
+}
+
+static char *ultoa(unsigned long v, char *s, int radix)
+{
+	char *p = s, *q, t;
+	do
+	{
+		*p++ = "0123456789abcdefghijklmnopqrstuvwxyz"[v % radix];
+		v /= radix;
+	}
+	while(v);
+
+	*p = '\0';
+	for(q = s, --p; q < p; ++q, --p)
+	{
+		t = *q;
+		*q = *p;
+		*p = t;
+	}
+
+	return s;
+}
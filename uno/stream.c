@@ -0,0 +1,349 @@
+/* Host side encoder for the binary protocol (proto.c), built with "make
+   stream". Reads raw 16x16 RGB frames (768 bytes each, e.g. from ffmpeg
+   with -f rawvideo -pix_fmt rgb24 -s 16x16) and sends every frame as the
+   smaller of an RLE frame and an XOR delta against the previous one.
+   Usage:
+
+     ./stream [-d device] [-b baud] [-k keyframes] [-r fps] [input]
+
+   With a device every packet waits for the answer of the board, a NAK
+   sends the next frame as a key frame. Without one the packets are
+   written to stdout. The sizes and the frame rate the link allows are
+   printed at the end. */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <util/crc16.h>
+
+#define STREAM_SIZE          16
+#define STREAM_PIXELS         (STREAM_SIZE * STREAM_SIZE)
+#define STREAM_BYTES          (STREAM_PIXELS * 3)
+#define STREAM_MAX            (STREAM_PIXELS * 4)
+#define STREAM_TIMEOUT      500
+
+/* See proto.c and MODE_STREAM in main.c */
+#define PROTO_SYNC         0xA5
+#define PROTO_ACK          0x06
+#define PROTO_NAK          0x15
+#define PROTO_MODE            4
+#define PROTO_RLE             5
+#define PROTO_DELTA           6
+#define PROTO_RUN          0x80
+#define MODE_STREAM           3
+
+static int _fd = -1;
+static long _baud = 500000;
+static unsigned long _keyframes = 100;
+static double _fps;
+
+static unsigned long _frames, _bytes, _deltas, _naks;
+
+static int stream_open(const char *device);
+static size_t stream_runs(const uint8_t *p, size_t end, uint8_t *out);
+static size_t stream_end(const uint8_t *p);
+static int stream_send(uint8_t type, const uint8_t *data, size_t len);
+static void stream_sleep(double s);
+static double stream_seconds(void);
+
+int main(int argc, char **argv)
+{
+	static uint8_t frame[STREAM_BYTES], last[STREAM_BYTES];
+	static uint8_t delta[STREAM_BYTES];
+	static uint8_t rle[STREAM_MAX], xor[STREAM_MAX];
+	const char *device = NULL;
+	size_t n, r, x;
+	uint8_t mode = MODE_STREAM, key = 1;
+	double t, next;
+	FILE *in = stdin;
+	int c, status;
+
+	while((c = getopt(argc, argv, "d:b:k:r:")) != -1)
+	{
+		switch(c)
+		{
+		case 'd':
+			device = optarg;
+			break;
+
+		case 'b':
+			_baud = atol(optarg);
+			break;
+
+		case 'k':
+			_keyframes = atol(optarg);
+			break;
+
+		case 'r':
+			_fps = atof(optarg);
+			break;
+
+		default:
+			fprintf(stderr, "usage: %s [-d device] [-b baud] "
+				"[-k keyframes] [-r fps] [input]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if(optind < argc && !(in = fopen(argv[optind], "rb")))
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+
+	if(device && stream_open(device))
+	{
+		return 1;
+	}
+
+	if(stream_send(PROTO_MODE, &mode, 1) < 0)
+	{
+		return 1;
+	}
+
+	next = stream_seconds();
+	while(fread(frame, 1, STREAM_BYTES, in) == STREAM_BYTES)
+	{
+		for(n = 0; n < STREAM_BYTES; ++n)
+		{
+			delta[n] = frame[n] ^ last[n];
+		}
+
+		r = stream_runs(frame, STREAM_PIXELS, rle);
+		x = stream_runs(delta, stream_end(delta), xor);
+		if(_keyframes && _frames % _keyframes == 0)
+		{
+			key = 1;
+		}
+
+		if(_fps > 0)
+		{
+			t = stream_seconds();
+			if(next > t)
+			{
+				stream_sleep(next - t);
+			}
+
+			next += 1 / _fps;
+		}
+
+		/* An empty delta is sent as one run of zeros */
+		if(!key && x < r)
+		{
+			status = stream_send(PROTO_DELTA, xor, x);
+			++_deltas;
+		}
+		else
+		{
+			status = stream_send(PROTO_RLE, rle, r);
+		}
+
+		if(status < 0)
+		{
+			return 1;
+		}
+
+		/* After a NAK the framebuffer may hold half a frame */
+		key = (status == 0);
+		memcpy(last, frame, STREAM_BYTES);
+		++_frames;
+	}
+
+	if(_frames)
+	{
+		fprintf(stderr, "%lu frames, %lu deltas, %lu NAKs, %.1f bytes "
+			"per frame instead of %d (%.1f%%)\n", _frames, _deltas, _naks,
+			(double)_bytes / _frames, STREAM_BYTES + 6,
+			_bytes * 100.0 / _frames / (STREAM_BYTES + 6));
+
+		fprintf(stderr, "%ld baud: %.1f fps, %.1f fps with full frames "
+			"(transfer only)\n", _baud, _baud / 10.0 * _frames / _bytes,
+			_baud / 10.0 / (STREAM_BYTES + 6));
+	}
+
+	return 0;
+}
+
+/* Raw, 8N1 */
+static int stream_open(const char *device)
+{
+	struct termios t;
+	speed_t speed;
+
+	switch(_baud)
+	{
+	case 9600: speed = B9600; break;
+	case 57600: speed = B57600; break;
+	case 115200: speed = B115200; break;
+	case 230400: speed = B230400; break;
+#ifdef B500000
+	case 500000: speed = B500000; break;
+#endif
+#ifdef B1000000
+	case 1000000: speed = B1000000; break;
+#endif
+	default:
+		fprintf(stderr, "%ld baud not supported\n", _baud);
+		return 1;
+	}
+
+	if((_fd = open(device, O_RDWR | O_NOCTTY)) < 0 || tcgetattr(_fd, &t))
+	{
+		perror(device);
+		return 1;
+	}
+
+	cfmakeraw(&t);
+	cfsetispeed(&t, speed);
+	cfsetospeed(&t, speed);
+	t.c_cflag |= CLOCAL | CREAD;
+	if(tcsetattr(_fd, TCSANOW, &t))
+	{
+		perror(device);
+		return 1;
+	}
+
+	/* The board resets when the port is opened */
+	stream_sleep(2);
+	tcflush(_fd, TCIOFLUSH);
+	return 0;
+}
+
+/* Runs as in proto.c over the pixels of p up to end */
+static size_t stream_runs(const uint8_t *p, size_t end, uint8_t *out)
+{
+	size_t i = 0, j, n, len = 0;
+	while(i < end)
+	{
+		/* Two equal pixels are shorter as a run */
+		for(n = 1; i + n < end && n < 128 &&
+			!memcmp(p + 3 * i, p + 3 * (i + n), 3); ++n) ;
+
+		if(n > 1)
+		{
+			out[len++] = PROTO_RUN | (n - 1);
+			memcpy(out + len, p + 3 * i, 3);
+			len += 3;
+			i += n;
+			continue;
+		}
+
+		for(j = i + 1; j < end && j - i < 128 &&
+			(j + 1 >= end || memcmp(p + 3 * j, p + 3 * (j + 1), 3)); ++j) ;
+
+		out[len++] = j - i - 1;
+		memcpy(out + len, p + 3 * i, 3 * (j - i));
+		len += 3 * (j - i);
+		i = j;
+	}
+
+	return len;
+}
+
+/* Pixels up to the last one that changed, the rest is left out */
+static size_t stream_end(const uint8_t *p)
+{
+	size_t n = STREAM_BYTES;
+	while(n && !p[n - 1])
+	{
+		--n;
+	}
+
+	return (n + 2) / 3;
+}
+
+/* Returns 1 for an ACK (or without a device), 0 for a NAK, -1 on errors */
+static int stream_send(uint8_t type, const uint8_t *data, size_t len)
+{
+	static const uint8_t empty[4] = { PROTO_RUN };
+	uint8_t head[4], crc[2], c;
+	uint16_t check = 0xFFFF;
+	struct pollfd p;
+	size_t i;
+
+	if(!data || !len)
+	{
+		data = empty;
+		len = sizeof(empty);
+	}
+
+	head[0] = PROTO_SYNC;
+	head[1] = len & 0xFF;
+	head[2] = len >> 8;
+	head[3] = type;
+	for(i = 1; i < sizeof(head); ++i)
+	{
+		check = _crc_ccitt_update(check, head[i]);
+	}
+
+	for(i = 0; i < len; ++i)
+	{
+		check = _crc_ccitt_update(check, data[i]);
+	}
+
+	crc[0] = check & 0xFF;
+	crc[1] = check >> 8;
+	_bytes += sizeof(head) + len + sizeof(crc);
+
+	if(_fd < 0)
+	{
+		fwrite(head, 1, sizeof(head), stdout);
+		fwrite(data, 1, len, stdout);
+		fwrite(crc, 1, sizeof(crc), stdout);
+		return ferror(stdout) ? -1 : 1;
+	}
+
+	if(write(_fd, head, sizeof(head)) != sizeof(head) ||
+		write(_fd, data, len) != (ssize_t)len ||
+		write(_fd, crc, sizeof(crc)) != sizeof(crc))
+	{
+		perror("write");
+		return -1;
+	}
+
+	/* Text output of the firmware is skipped */
+	p.fd = _fd;
+	p.events = POLLIN;
+	while(poll(&p, 1, STREAM_TIMEOUT) > 0)
+	{
+		if(read(_fd, &c, 1) != 1)
+		{
+			break;
+		}
+
+		if(c == PROTO_ACK)
+		{
+			return 1;
+		}
+
+		if(c == PROTO_NAK)
+		{
+			++_naks;
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "no answer from the board\n");
+	return -1;
+}
+
+static void stream_sleep(double s)
+{
+	struct timespec t;
+	t.tv_sec = s;
+	t.tv_nsec = (s - t.tv_sec) * 1e9;
+	nanosleep(&t, NULL);
+}
+
+static double stream_seconds(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
@@ -0,0 +1,74 @@
+/* Host side table of the WS2812 bit timing, built with "make timing".
+   Uses the same macros as ws2812.c and checks every chipset, clock
+   frequency and backend against the data sheet limits. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ws2812_timing.h"
+
+#define ARRLEN(a) (sizeof(a) / sizeof(*a))
+
+static const long _freqs[] = { 8000000, 12000000, 16000000, 20000000 };
+static const char *_status[] = { "FAIL T0H", "FAIL T1H/period", "OK" };
+static int _failed;
+
+static void row(const char *chip, const char *backend, long f,
+	long t0h, long t1h, long period, int nops, int status);
+
+#define ROWS(c, f) \
+	row(#c, "single", f, W_T0H_OF(f, c), W_T1H_OF(f, c), \
+		W_PERIOD_OF(f, c), W1_OF(f, c) + W2_OF(f, c) + W3_OF(f, c), \
+		W_CHECK(c, W_T0H_OF(f, c), W_T1H_OF(f, c), W_PERIOD_OF(f, c))); \
+	row(#c, "dual", f, WD_T0H_OF(f, c), WD_T1H_OF(f, c), \
+		WD_PERIOD_OF(f, c), WD1_OF(f, c) + WD2_NOPS_OF(f, c) + \
+		WD3_OF(f, c), W_CHECK(c, WD_T0H_OF(f, c), WD_T1H_OF(f, c), \
+		WD_PERIOD_OF(f, c))); \
+	row(#c, "spi", f, WS_SPI_T0H_OF(f, c), WS_SPI_T1H_OF(f, c), \
+		WS_SPI_PERIOD_OF(f, c), -1, W_CHECK(c, WS_SPI_T0H_OF(f, c), \
+		WS_SPI_T1H_OF(f, c), WS_SPI_PERIOD_OF(f, c)))
+
+int main(void)
+{
+	unsigned i;
+	long f;
+	printf("%-8s %-7s %5s %5s %5s %6s %5s  %s\n", "chipset", "backend",
+		"MHz", "T0H", "T1H", "period", "nops", "status");
+
+	for(i = 0; i < ARRLEN(_freqs); ++i)
+	{
+		f = _freqs[i];
+		ROWS(WS2812B, f);
+		ROWS(SK6812, f);
+		ROWS(WS2811, f);
+	}
+
+	/* The SPI times are nominal, gaps between two SPI bytes only
+	   stretch the low time and are not part of the table */
+	return _failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void row(const char *chip, const char *backend, long f,
+	long t0h, long t1h, long period, int nops, int status)
+{
+	printf("%-8s %-7s %5ld %5ld %5ld %6ld ", chip, backend, f / 1000000,
+		t0h, t1h, period);
+
+	if(nops < 0)
+	{
+		printf("%5s", "-");
+	}
+	else
+	{
+		printf("%5d", nops);
+	}
+
+	printf("  %s\n", _status[status]);
+
+	/* Every failure stops the firmware build. The SPI backend is
+	   optional, only the bit banged ones have to work everywhere */
+	if(status != 2 && backend[0] != 's')
+	{
+		_failed = 1;
+	}
+}
@@ -0,0 +1,219 @@
+/* UART, shared by uno and uno_tester. Host builds get uart_tx() and
+   uart_rx() from the simulation (sim.c).
+
+   Received bytes are moved into a ring buffer by USART_RX_vect, so a
+   busy main loop only has to catch up later. The interrupt is short
+   enough to run in the windows of WS2812_IRQ_WINDOW during a frame.
+   Bytes lost to a full ring or to a hardware overrun (DOR0) are counted
+   in _uart_overrun.
+
+   Sent bytes go into a second ring drained by USART_UDRE_vect, so
+   uart_tx() returns at once. When that ring is full the byte is dropped
+   and counted in _uart_tx_dropped, unless _uart_tx_block is set, then
+   uart_tx() waits for room. UART_TX_BLOCK selects the default. */
+#ifndef UART_BAUD
+#define UART_BAUD         9600
+#endif
+
+/* Power of two */
+#ifndef UART_RX_SIZE
+#define UART_RX_SIZE         32
+#endif
+
+/* Power of two */
+#ifndef UART_TX_SIZE
+#define UART_TX_SIZE         64
+#endif
+
+#ifndef UART_TX_BLOCK
+#define UART_TX_BLOCK         0
+#endif
+
+/* Double speed above 57600 baud, the divider is finer then */
+#ifndef UART_U2X
+#define UART_U2X              (UART_BAUD > 57600)
+#endif
+
+#if UART_U2X
+#define UART_PRESCALER        (uint16_t)(F_CPU / UART_BAUD / 8 - 0.5)
+#else
+#define UART_PRESCALER        (uint16_t)(F_CPU / UART_BAUD / 16 - 0.5)
+#endif
+
+static void uart_init(void);
+void uart_tx(char c);
+void uart_tx_s(const char *s);
+void uart_tx_P(const char *s);
+int16_t uart_rx(void);
+int16_t uart_line_put(char *buf, uint8_t size, char c);
+int16_t uart_line(char *buf, uint8_t size);
+
+static volatile uint8_t _uart_overrun;
+static volatile uint8_t _uart_tx_dropped;
+static uint8_t _uart_line_len;
+uint8_t _uart_tx_block = UART_TX_BLOCK;
+
+#if !(defined(HOST) && HOST)
+static volatile char _uart_rx_buf[UART_RX_SIZE];
+static volatile uint8_t _uart_rx_head, _uart_rx_tail;
+static volatile char _uart_tx_buf[UART_TX_SIZE];
+static volatile uint8_t _uart_tx_head, _uart_tx_tail;
+#endif
+
+static void uart_init(void)
+{
+	UBRR0 = UART_PRESCALER;
+#if UART_U2X
+	UCSR0A = (1 << U2X0);
+#else
+	UCSR0A = 0;
+#endif
+	UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+	UCSR0B = (1 << RXCIE0) | (1 << RXEN0) | (1 << TXEN0);
+}
+
+#if !(defined(HOST) && HOST)
+void uart_tx(char c)
+{
+	uint8_t head = _uart_tx_head, next = (head + 1) & (UART_TX_SIZE - 1);
+	uint8_t tail;
+	while(next == (tail = _uart_tx_tail))
+	{
+		if(!_uart_tx_block)
+		{
+			if(_uart_tx_dropped < 255)
+			{
+				++_uart_tx_dropped;
+			}
+
+			return;
+		}
+
+		if(!(SREG & (1 << SREG_I)))
+		{
+			/* Interrupts are off, drain one byte by hand */
+			while(!(UCSR0A & (1 << UDRE0))) ;
+			UDR0 = _uart_tx_buf[tail];
+			_uart_tx_tail = (tail + 1) & (UART_TX_SIZE - 1);
+		}
+	}
+
+	_uart_tx_buf[head] = c;
+	_uart_tx_head = next;
+	UCSR0B |= (1 << UDRIE0);
+}
+
+ISR(USART_UDRE_vect)
+{
+	uint8_t tail = _uart_tx_tail;
+	if(tail == _uart_tx_head)
+	{
+		UCSR0B &= ~(1 << UDRIE0);
+		return;
+	}
+
+	UDR0 = _uart_tx_buf[tail];
+	_uart_tx_tail = (tail + 1) & (UART_TX_SIZE - 1);
+}
+#endif
+
+void uart_tx_s(const char *s)
+{
+	register char c;
+	while((c = *s++))
+	{
+		uart_tx(c);
+	}
+}
+
+void uart_tx_P(const char *s)
+{
+	register char c;
+	while((c = pgm_read_byte(s++)))
+	{
+		uart_tx(c);
+	}
+}
+
+#if !(defined(HOST) && HOST)
+int16_t uart_rx(void)
+{
+	uint8_t tail = _uart_rx_tail;
+	char c;
+	if(tail == _uart_rx_head)
+	{
+		return -1;
+	}
+
+	c = _uart_rx_buf[tail];
+	_uart_rx_tail = (tail + 1) & (UART_RX_SIZE - 1);
+	return (uint8_t)c;
+}
+
+ISR(USART_RX_vect)
+{
+	uint8_t head = _uart_rx_head, next = (head + 1) & (UART_RX_SIZE - 1);
+	uint8_t status = UCSR0A;
+	char c = UDR0;
+
+	if(status & (1 << DOR0))
+	{
+		/* At least one byte was lost before this one */
+		if(_uart_overrun < 255)
+		{
+			++_uart_overrun;
+		}
+	}
+
+	if(next == _uart_rx_tail)
+	{
+		if(_uart_overrun < 255)
+		{
+			++_uart_overrun;
+		}
+
+		return;
+	}
+
+	_uart_rx_buf[head] = c;
+	_uart_rx_head = next;
+}
+#endif
+
+/* Adds a received byte to the line in buf. Returns the length of the
+   line (terminated, without '\r' and '\n') when c is '\n', -1 while the
+   line is incomplete. Characters that do not fit are dropped, the line is
+   still returned. */
+int16_t uart_line_put(char *buf, uint8_t size, char c)
+{
+	uint8_t n;
+	if(c == '\n')
+	{
+		n = _uart_line_len;
+		buf[n] = '\0';
+		_uart_line_len = 0;
+		return n;
+	}
+
+	if(c != '\r' && _uart_line_len < size - 1)
+	{
+		buf[_uart_line_len++] = c;
+	}
+
+	return -1;
+}
+
+/* Returns the length of the next complete line, -1 if there is none */
+int16_t uart_line(char *buf, uint8_t size)
+{
+	int16_t c, n;
+	while((c = uart_rx()) >= 0)
+	{
+		if((n = uart_line_put(buf, size, c)) >= 0)
+		{
+			return n;
+		}
+	}
+
+	return -1;
+}
@@ -0,0 +1,125 @@
+/* Vote aggregation. Every vote (0..255) goes into
+
+   - a sliding window of VOTE_WINDOW minutes, split into VOTE_SLOTS
+     slots of sum and count, the oldest slot is dropped as time passes
+   - an exponential moving average in 8.8 fixed point, weight
+     1 / 2^VOTE_EMA_SHIFT, it keeps the last mood when the window is empty
+   - a histogram of 256 bins, halved when one of them is full, so old
+     votes fade by the number of votes since, not by their age
+
+   vote_add() only adds and shifts. The one division is in vote_update(),
+   called once after a batch of votes or when votes expired, vote_value()
+   returns its result. VOTE_WINDOW 0 keeps all votes since power-on, a
+   full slot is halved then instead of wrapping. */
+#ifndef VOTE_WINDOW
+#define VOTE_WINDOW          10
+#endif
+
+#ifndef VOTE_SLOTS
+#define VOTE_SLOTS           10
+#endif
+
+#ifndef VOTE_EMA_SHIFT
+#define VOTE_EMA_SHIFT        4
+#endif
+
+#define VOTE_SLOT_MS          ((uint32_t)VOTE_WINDOW * 60000 / VOTE_SLOTS)
+
+typedef struct VOTE_SLOT
+{
+	uint32_t sum;
+	uint16_t count;
+} vote_slot_t;
+
+static vote_slot_t _vote_slots[VOTE_SLOTS];
+static uint8_t _vote_slot;
+#if VOTE_WINDOW
+static uint32_t _vote_slot_ms;
+#endif
+static uint32_t _vote_sum, _vote_count;
+static uint16_t _vote_ema = 255 << 8;
+static uint8_t _vote_bins[256];
+static uint8_t _vote_value = 255;
+
+static void vote_add(uint8_t v);
+static uint8_t vote_tick(void);
+static void vote_update(void);
+static uint8_t vote_value(void);
+
+static void vote_add(uint8_t v)
+{
+	vote_slot_t *s = &_vote_slots[_vote_slot];
+	uint16_t i;
+
+	if(s->count == 0xFFFF)
+	{
+		_vote_sum -= s->sum - (s->sum >> 1);
+		_vote_count -= s->count - (s->count >> 1);
+		s->sum >>= 1;
+		s->count >>= 1;
+	}
+
+	s->sum += v;
+	++s->count;
+	_vote_sum += v;
+	++_vote_count;
+
+	_vote_ema += ((int32_t)((uint16_t)v << 8) - _vote_ema) >> VOTE_EMA_SHIFT;
+
+	if(++_vote_bins[v] == 255)
+	{
+		for(i = 0; i < 256; ++i)
+		{
+			_vote_bins[i] >>= 1;
+		}
+	}
+}
+
+/* Drops the slots that left the window, returns 1 if votes expired */
+static uint8_t vote_tick(void)
+{
+#if VOTE_WINDOW
+	vote_slot_t *s;
+	uint32_t now = ms();
+	uint8_t expired = 0;
+	while(now - _vote_slot_ms >= VOTE_SLOT_MS)
+	{
+		_vote_slot_ms += VOTE_SLOT_MS;
+		if(++_vote_slot == VOTE_SLOTS)
+		{
+			_vote_slot = 0;
+		}
+
+		s = &_vote_slots[_vote_slot];
+		if(s->count)
+		{
+			_vote_sum -= s->sum;
+			_vote_count -= s->count;
+			s->sum = 0;
+			s->count = 0;
+			expired = 1;
+		}
+	}
+
+	return expired;
+#else
+	return 0;
+#endif
+}
+
+/* Average of the window, the moving average if it is empty */
+static void vote_update(void)
+{
+	if(!_vote_count)
+	{
+		_vote_value = (_vote_ema + 0x80) >> 8;
+		return;
+	}
+
+	_vote_value = (_vote_sum + _vote_count / 2) / _vote_count;
+}
+
+static uint8_t vote_value(void)
+{
+	return _vote_value;
+}
@@ -1,60 +1,159 @@
 #define WS2812_OUT            PORTB
 #define WS2812_DIR            DDRB
+#define WS2812_PIN_A           1
+#define WS2812_PIN_B           2
+
+#include "ws2812_timing.h"
+
+#ifndef LED_CHIPSET
+#define LED_CHIPSET     WS2812B
+#endif
+
+#define LED_CHANNELS          W_CHIP(LED_CHIPSET, CHANNELS)
 
 #define LED_SIZE            16
 #define LED_PIXELS            (LED_SIZE * LED_SIZE)
-#define LED_BYTES             (3 * LED_PIXELS)
+#define LED_HALF_PIXELS       (LED_PIXELS / 2)
+
+/* Panel wiring: the strip runs along columns (or rows), every other line
+   runs backwards if serpentine. The flip options select the edge the
+   first line starts on and the end of that line the strip starts at. */
+#ifndef LED_COLUMN_MAJOR
+#define LED_COLUMN_MAJOR       1
+#endif
+
+#ifndef LED_SERPENTINE
+#define LED_SERPENTINE         1
+#endif
+
+#ifndef LED_FLIP_MAJOR
+#define LED_FLIP_MAJOR         0
+#endif
+
+#ifndef LED_FLIP_MINOR
+#define LED_FLIP_MINOR         1
+#endif
+
+#if (LED_PIXELS > 256)
+#error "LED map entries are 8 bit"
+#endif
+
+#if LED_COLUMN_MAJOR
+#define LED_MAJOR(x, y)       (x)
+#define LED_MINOR(x, y)       (y)
+#else
+#define LED_MAJOR(x, y)       (y)
+#define LED_MINOR(x, y)       (x)
+#endif
 
-#define W_ZERO_PULSE    350
-#define W_ONE_PULSE     900
-#define W_TOTAL_PERIOD 1250
-#define W_FIXED_LOW       2
-#define W_FIXED_HIGH      4
-#define W_FIXED_TOTAL     8
+#define LED_LINE(x, y) \
+	(LED_FLIP_MAJOR ? (LED_SIZE - 1 - LED_MAJOR(x, y)) : LED_MAJOR(x, y))
 
-#define W_ZERO_CYCLE \
-	(((F_CPU / 1000) * W_ZERO_PULSE) / 1000000)
+#define LED_REVERSE(x, y) \
+	(LED_FLIP_MINOR ^ (LED_SERPENTINE && (LED_LINE(x, y) & 1)))
 
-#define W_ONE_CYCLE \
-	(((F_CPU / 1000) * W_ONE_PULSE + 500000) / 1000000)
+#define LED_MAP(x, y) \
+	(LED_SIZE * LED_LINE(x, y) + (LED_REVERSE(x, y) ? \
+		(LED_SIZE - 1 - LED_MINOR(x, y)) : LED_MINOR(x, y)))
 
-#define W_TOTAL_CYCLE \
-	(((F_CPU / 1000) * W_TOTAL_PERIOD + 500000) / 1000000)
+#define LED_ROW8(y, x) \
+	LED_MAP(x, y), LED_MAP(x + 1, y), LED_MAP(x + 2, y), LED_MAP(x + 3, y), \
+	LED_MAP(x + 4, y), LED_MAP(x + 5, y), LED_MAP(x + 6, y), LED_MAP(x + 7, y)
 
-#define W1 \
-	(W_ZERO_CYCLE - W_FIXED_LOW)
+#if (LED_SIZE == 8)
+#define LED_ROW(y)            { LED_ROW8(y, 0) }
+#elif (LED_SIZE == 16)
+#define LED_ROW(y)            { LED_ROW8(y, 0), LED_ROW8(y, 8) }
+#else
+#error "LED_SIZE must be 8 or 16"
+#endif
 
-#define W2 \
-	(W_ONE_CYCLE - W_FIXED_HIGH - W1)
+#define LED_ROWS8(y) \
+	LED_ROW(y), LED_ROW(y + 1), LED_ROW(y + 2), LED_ROW(y + 3), \
+	LED_ROW(y + 4), LED_ROW(y + 5), LED_ROW(y + 6), LED_ROW(y + 7)
 
-#define W3 \
-	(W_TOTAL_CYCLE - W_FIXED_TOTAL - W1 - W2)
+#if defined(LED_PALETTE) && LED_PALETTE
+#ifndef LED_PALETTE_SIZE
+#define LED_PALETTE_SIZE     16
+#endif
 
-#if (W1 > 0)
-#define W1_NOPS W1
+#define LED_PIXEL_BYTES        1
+#define LED_FETCH(p)          (_palette[*(p)++])
 #else
-#define W1_NOPS  0
+#define LED_PIXEL_BYTES       LED_CHANNELS
+#define LED_FETCH(p)          ((p) += LED_CHANNELS, (p) - LED_CHANNELS)
 #endif
 
-#define W_LOW_TIME \
-	(((W1_NOPS + W_FIXED_LOW) * 1000000) / (F_CPU / 1000))
+#define LED_BYTES             (LED_PIXEL_BYTES * LED_PIXELS)
+#define LED_HALF_BYTES        (LED_BYTES / 2)
 
-#if (W_LOW_TIME > 550)
-#error "F_CPU to low"
-#elif (W_LOW_TIME > 450)
-#warning "Critical timing"
+/* An RGBW framebuffer takes 1 KB and leaves no room for the stack */
+#if (LED_CHANNELS == 4) && !(defined(LED_PALETTE) && LED_PALETTE) && \
+	!(defined(HOST) && HOST)
+#error "4 channel chipsets need LED_PALETTE"
 #endif
 
-#if (W2 > 0)
-#define W2_NOPS W2
+#define W1_NOPS               W1_OF(F_CPU, LED_CHIPSET)
+#define W2_NOPS               W2_OF(F_CPU, LED_CHIPSET)
+#define W3_NOPS               W3_OF(F_CPU, LED_CHIPSET)
+
+#define WD1_NOPS              WD1_OF(F_CPU, LED_CHIPSET)
+#define WD_PRE                WD_PRE_OF(F_CPU, LED_CHIPSET)
+#define WD2_NOPS              WD2_NOPS_OF(F_CPU, LED_CHIPSET)
+#define WD3_NOPS              WD3_OF(F_CPU, LED_CHIPSET)
+
+#if defined(WS2812_SPI) && WS2812_SPI
+#define W_STATUS \
+	W_CHECK(LED_CHIPSET, WS_SPI_T0H_OF(F_CPU, LED_CHIPSET), \
+		WS_SPI_T1H_OF(F_CPU, LED_CHIPSET), \
+		WS_SPI_PERIOD_OF(F_CPU, LED_CHIPSET))
 #else
-#define W2_NOPS  0
+#define W_STATUS \
+	W_CHECK(LED_CHIPSET, W_T0H_OF(F_CPU, LED_CHIPSET), \
+		W_T1H_OF(F_CPU, LED_CHIPSET), W_PERIOD_OF(F_CPU, LED_CHIPSET))
 #endif
 
-#if (W3 > 0)
-#define W3_NOPS W3
+#if defined(WS2812_DUAL) && WS2812_DUAL && \
+	!(defined(WS2812_SPI) && WS2812_SPI)
+#define WD_STATUS \
+	W_CHECK(LED_CHIPSET, WD_T0H_OF(F_CPU, LED_CHIPSET), \
+		WD_T1H_OF(F_CPU, LED_CHIPSET), WD_PERIOD_OF(F_CPU, LED_CHIPSET))
+#else
+#define WD_STATUS         2
+#endif
+
+#if (W_STATUS == 0 || WD_STATUS == 0)
+#error "F_CPU not supported for this chipset, T0H out of spec"
+#elif (W_STATUS == 1 || WD_STATUS == 1)
+#error "F_CPU not supported for this chipset, T1H or period out of spec"
+#endif
+
+#define WD_OP1  "       lsl   %2    \n\t"
+#define WD_OP2  "       bst   %2,7  \n\t"
+#define WD_OP3  "       bld   %1,%7 \n\t"
+#define WD_OP4  "       lsl   %3    \n\t"
+#define WD_OP5  "       bst   %3,7  \n\t"
+#define WD_OP6  "       bld   %1,%8 \n\t"
+
+/* SPI: both halves have to be chained and connected to MOSI */
+#define WS2812_SPI_DDR        DDRB
+#define WS2812_SPI_PORT       PORTB
+#define WS2812_SPI_MOSI        3
+#define WS2812_SPI_SCK         5
+#define WS2812_SPI_SS          2
+
+#define WS_SPI_DIV            WS_SPI_DIV_OF(F_CPU)
+#define WS_SPI_ONE            (WS_SPI_ONE_OF(F_CPU, LED_CHIPSET) == 3 ? 0xE : 0xC)
+
+#if (WS_SPI_DIV == 2)
+#define WS_SPI_SPCR       0
+#define WS_SPI_SPSR       (1 << SPI2X)
+#elif (WS_SPI_DIV == 4)
+#define WS_SPI_SPCR       0
+#define WS_SPI_SPSR       0
 #else
-#define W3_NOPS  0
+#define WS_SPI_SPCR       (1 << SPR0)
+#define WS_SPI_SPSR       (1 << SPI2X)
 #endif
 
 #define W_NOP1  "nop      \n\t"
@@ -63,48 +162,392 @@
 #define W_NOP8  W_NOP4 W_NOP4
 #define W_NOP16 W_NOP8 W_NOP8
 
+#define LED_DIRTY_A           1
+#define LED_DIRTY_B           2
+
+/* Called after a frame has been sent */
+#ifndef LED_SHOWN
+#define LED_SHOWN()
+#endif
+
+#ifndef DEFAULT_BRIGHTNESS
+#define DEFAULT_BRIGHTNESS   64
+#endif
+
+/* Power budget in mA, 0 disables the limiter. The estimate assumes
+   LED_POWER_CHANNEL mA per colour channel at full intensity plus the
+   quiescent current of the board, gamma correction is not taken into
+   account, so it errs on the safe side. */
+#ifndef LED_POWER_BUDGET
+#define LED_POWER_BUDGET   2000
+#endif
+
+#define LED_POWER_CHANNEL    20
+#define LED_POWER_IDLE        (LED_PIXELS * 6 / 10)
+
+#if (LED_CHANNELS == 4)
+#define LED_SUM(p)            ((uint16_t)(p)[0] + (p)[1] + (p)[2] + (p)[3])
+#else
+#define LED_SUM(p)            ((uint16_t)(p)[0] + (p)[1] + (p)[2])
+#endif
+
+/* Gamma correction and brightness are applied to every byte while it is
+   sent. This runs between two bytes and only stretches the low time of
+   the last bit, the bit timing checked above is not affected. */
+#define LED_SCALE(v, s)       (((uint16_t)(v) * (s) + (v)) >> 8)
+
+#if defined(LED_GAMMA) && LED_GAMMA
+#define LED_OUT(v)            LED_SCALE(pgm_read_byte(_gamma + (v)), _scale)
+#else
+#define LED_OUT(v)            LED_SCALE(v, _scale)
+#endif
+
 typedef struct COLOR { uint8_t R, G, B; } color_t;
 static uint8_t _pixels[LED_BYTES];
+static uint8_t _dirty;
+static uint8_t _brightness = DEFAULT_BRIGHTNESS;
+static uint8_t _scale;
+static uint32_t _power;
+
+#if defined(LED_GAMMA) && LED_GAMMA
+/* pow(i / 255, 2.8) * 255 */
+static const uint8_t _gamma[256] PROGMEM =
+{
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,
+	  1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+	  2,   3,   3,   3,   3,   3,   3,   3,   4,   4,   4,   4,   4,   5,   5,   5,
+	  5,   6,   6,   6,   6,   7,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,
+	 10,  10,  11,  11,  11,  12,  12,  13,  13,  13,  14,  14,  15,  15,  16,  16,
+	 17,  17,  18,  18,  19,  19,  20,  20,  21,  21,  22,  22,  23,  24,  24,  25,
+	 25,  26,  27,  27,  28,  29,  29,  30,  31,  32,  32,  33,  34,  35,  35,  36,
+	 37,  38,  39,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  50,
+	 51,  52,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,  64,  66,  67,  68,
+	 69,  70,  72,  73,  74,  75,  77,  78,  79,  81,  82,  83,  85,  86,  87,  89,
+	 90,  92,  93,  95,  96,  98,  99, 101, 102, 104, 105, 107, 109, 110, 112, 114,
+	115, 117, 119, 120, 122, 124, 126, 127, 129, 131, 133, 135, 137, 138, 140, 142,
+	144, 146, 148, 150, 152, 154, 156, 158, 160, 162, 164, 167, 169, 171, 173, 175,
+	177, 180, 182, 184, 186, 189, 191, 193, 196, 198, 200, 203, 205, 208, 210, 213,
+	215, 218, 220, 223, 225, 228, 231, 233, 236, 239, 241, 244, 247, 249, 252, 255
+};
+#endif
+
+/* Strip index of every pixel, _led_map[y][x] */
+static const uint8_t _led_map[LED_SIZE][LED_SIZE] PROGMEM =
+{
+#if (LED_SIZE == 8)
+	LED_ROWS8(0)
+#else
+	LED_ROWS8(0),
+	LED_ROWS8(8)
+#endif
+};
+
+#if defined(LED_PALETTE) && LED_PALETTE
+/* Palette entries are stored in wire order */
+static uint8_t _palette[LED_PALETTE_SIZE][LED_CHANNELS];
+static uint8_t _palette_len;
+
+static uint8_t led_palette_index(color_t *c);
+#endif
 
 static void led_update(void);
+static void led_encode(uint8_t *w, color_t *c);
+static void led_set(uint8_t i, color_t *c);
+#if defined(PROTO) && PROTO
+static void led_get(uint8_t i, color_t *c);
+#endif
 static void led_pixel(uint8_t x, uint8_t y, color_t *c);
+static void led_row(uint8_t y, uint16_t bits, color_t *c);
+static void led_column(uint8_t x, uint16_t bits, color_t *c);
 static void led_clear(color_t *c);
+static void led_brightness(uint8_t b);
+#if LED_POWER_BUDGET
+static uint16_t led_current(uint8_t scale);
+#endif
+#if defined(HOST) && HOST
+static void ws2812_host(uint8_t *pixels, uint16_t count);
+#elif defined(WS2812_SPI) && WS2812_SPI
+static void ws2812_spi(uint8_t *pixels, uint16_t count);
+#else
 static void ws2812(uint8_t *pixels, uint16_t count, uint8_t pin);
+#if defined(WS2812_DUAL) && WS2812_DUAL
+static void ws2812_dual(uint8_t *a, uint8_t *b, uint16_t count);
+#endif
+#endif
 
+/* Only the halves that changed since the last update are sent */
 static void led_update(void)
 {
-	ws2812(_pixels, 128 * 3, 1);
-	ws2812(_pixels + 128 * 3, 128 * 3, 2);
+	uint8_t scale = _brightness, sent;
+#if LED_POWER_BUDGET
+	uint16_t ma = led_current(scale);
+	if(ma > LED_POWER_BUDGET)
+	{
+		scale = ((uint32_t)scale * (LED_POWER_BUDGET - LED_POWER_IDLE)) /
+			(ma - LED_POWER_IDLE);
+	}
+#endif
+
+	/* A different scale has to be applied to both halves */
+	if(scale != _scale)
+	{
+		_scale = scale;
+		_dirty = LED_DIRTY_A | LED_DIRTY_B;
+	}
+
+	sent = _dirty;
+#if defined(HOST) && HOST
+	if(_dirty)
+	{
+		ws2812_host(_pixels, LED_PIXELS);
+	}
+#elif defined(WS2812_SPI) && WS2812_SPI
+	if(_dirty & LED_DIRTY_B)
+	{
+		ws2812_spi(_pixels, LED_PIXELS);
+	}
+	else if(_dirty & LED_DIRTY_A)
+	{
+		ws2812_spi(_pixels, LED_HALF_PIXELS);
+	}
+#else
+#if defined(WS2812_DUAL) && WS2812_DUAL
+	if(_dirty == (LED_DIRTY_A | LED_DIRTY_B))
+	{
+		ws2812_dual(_pixels, _pixels + LED_HALF_BYTES, LED_HALF_PIXELS);
+		_dirty = 0;
+	}
+#endif
+
+	if(_dirty & LED_DIRTY_A)
+	{
+		ws2812(_pixels, LED_HALF_PIXELS, WS2812_PIN_A);
+	}
+
+	if(_dirty & LED_DIRTY_B)
+	{
+		ws2812(_pixels + LED_HALF_BYTES, LED_HALF_PIXELS, WS2812_PIN_B);
+	}
+#endif
+
+	_dirty = 0;
+	if(sent)
+	{
+		LED_SHOWN();
+	}
+}
+
+/* Converts a colour to the wire order of the chipset. On RGBW strips the
+   part common to all three channels is shown by the white LED. */
+static void led_encode(uint8_t *w, color_t *c)
+{
+	uint8_t r = c->R, g = c->G, b = c->B;
+#if (LED_CHANNELS == 4)
+	uint8_t m = (r < g) ? r : g;
+	if(b < m)
+	{
+		m = b;
+	}
+
+	r -= m;
+	g -= m;
+	b -= m;
+	w[3] = m;
+#endif
+
+#if W_CHIP(LED_CHIPSET, GRB)
+	w[0] = g;
+	w[1] = r;
+#else
+	w[0] = r;
+	w[1] = g;
+#endif
+	w[2] = b;
+}
+
+#if defined(PROTO) && PROTO
+/* Colour of a pixel, the inverse of led_encode(). Only the delta frames
+   of the binary protocol read pixels back. */
+static void led_get(uint8_t i, color_t *c)
+{
+#if defined(LED_PALETTE) && LED_PALETTE
+	uint8_t *p = _palette[_pixels[i]];
+#else
+	uint8_t *p = _pixels + LED_CHANNELS * i;
+#endif
+#if W_CHIP(LED_CHIPSET, GRB)
+	c->G = p[0];
+	c->R = p[1];
+#else
+	c->R = p[0];
+	c->G = p[1];
+#endif
+	c->B = p[2];
+#if (LED_CHANNELS == 4)
+	c->R += p[3];
+	c->G += p[3];
+	c->B += p[3];
+#endif
+}
+#endif
+
+static void led_set(uint8_t i, color_t *c)
+{
+#if defined(LED_PALETTE) && LED_PALETTE
+	uint8_t v = led_palette_index(c);
+	if(_pixels[i] != v)
+	{
+		_power += LED_SUM(_palette[v]);
+		_power -= LED_SUM(_palette[_pixels[i]]);
+		_pixels[i] = v;
+		_dirty |= (i < LED_HALF_PIXELS) ? LED_DIRTY_A : LED_DIRTY_B;
+	}
+#else
+	uint8_t w[LED_CHANNELS], j;
+	uint8_t *p = _pixels + LED_CHANNELS * i;
+	led_encode(w, c);
+	for(j = 0; j < LED_CHANNELS && p[j] == w[j]; ++j) ;
+	if(j < LED_CHANNELS)
+	{
+		_power += LED_SUM(w);
+		_power -= LED_SUM(p);
+		for(j = 0; j < LED_CHANNELS; ++j)
+		{
+			p[j] = w[j];
+		}
+
+		_dirty |= (i < LED_HALF_PIXELS) ? LED_DIRTY_A : LED_DIRTY_B;
+	}
+#endif
 }
 
 static void led_pixel(uint8_t x, uint8_t y, color_t *c)
 {
 	if(x < LED_SIZE && y < LED_SIZE)
 	{
-		uint16_t i;
-		y = LED_SIZE - 1 - y;
-		i = 3 * ((x % 2) ? ((LED_SIZE * x) + ((LED_SIZE - 1) - y)) :
-			(LED_SIZE * x + y));
-		_pixels[i] = c->G;
-		_pixels[++i] = c->R;
-		_pixels[++i] = c->B;
+		led_set(pgm_read_byte(&_led_map[y][x]), c);
+	}
+}
+
+/* Bit n of bits is column n */
+static void led_row(uint8_t y, uint16_t bits, color_t *c)
+{
+	uint8_t x;
+	const uint8_t *m = _led_map[y];
+	for(x = 0; x < LED_SIZE; ++x, bits >>= 1)
+	{
+		if(bits & 1)
+		{
+			led_set(pgm_read_byte(m + x), c);
+		}
+	}
+}
+
+/* Bit n of bits is row n */
+static void led_column(uint8_t x, uint16_t bits, color_t *c)
+{
+	uint8_t y;
+	const uint8_t *m = &_led_map[0][x];
+	for(y = 0; y < LED_SIZE; ++y, bits >>= 1, m += LED_SIZE)
+	{
+		if(bits & 1)
+		{
+			led_set(pgm_read_byte(m), c);
+		}
 	}
 }
 
 static void led_clear(color_t *c)
 {
 	uint16_t i;
-	for(i = 0; i < 3 * LED_PIXELS; ++i)
+	uint8_t w[LED_CHANNELS];
+	led_encode(w, c);
+#if defined(LED_PALETTE) && LED_PALETTE
+	_palette_len = 0;
+	led_palette_index(c);
+	for(i = 0; i < LED_PIXELS; ++i)
+	{
+		_pixels[i] = 0;
+	}
+#else
+	for(i = 0; i < LED_BYTES; ++i)
+	{
+		_pixels[i] = w[i % LED_CHANNELS];
+	}
+#endif
+
+	_power = (uint32_t)LED_PIXELS * LED_SUM(w);
+	_dirty = LED_DIRTY_A | LED_DIRTY_B;
+}
+
+static void led_brightness(uint8_t b)
+{
+	_brightness = b;
+	_dirty = LED_DIRTY_A | LED_DIRTY_B;
+}
+
+#if LED_POWER_BUDGET
+/* Estimated current of the framebuffer at the given scale in mA */
+static uint16_t led_current(uint8_t scale)
+{
+	return LED_POWER_IDLE +
+		((_power * (scale + 1) >> 8) * LED_POWER_CHANNEL) / 255;
+}
+#endif
+
+#if defined(LED_PALETTE) && LED_PALETTE
+/* Returns the palette entry for a colour, a new entry is added if there
+   is room left, otherwise the closest entry is used */
+static uint8_t led_palette_index(color_t *c)
+{
+	uint8_t w[LED_CHANNELS], i, j, best;
+	uint16_t d, min;
+	led_encode(w, c);
+	for(i = 0; i < _palette_len; ++i)
+	{
+		for(j = 0; j < LED_CHANNELS && _palette[i][j] == w[j]; ++j) ;
+		if(j == LED_CHANNELS)
+		{
+			return i;
+		}
+	}
+
+	if(_palette_len < LED_PALETTE_SIZE)
+	{
+		for(j = 0; j < LED_CHANNELS; ++j)
+		{
+			_palette[i][j] = w[j];
+		}
+
+		return _palette_len++;
+	}
+
+	best = 0;
+	min = 0xFFFF;
+	for(i = 0; i < LED_PALETTE_SIZE; ++i)
 	{
-		_pixels[i] = c->G;
-		_pixels[++i] = c->R;
-		_pixels[++i] = c->B;
+		d = 0;
+		for(j = 0; j < LED_CHANNELS; ++j)
+		{
+			d += abs(_palette[i][j] - w[j]);
+		}
+
+		if(d < min)
+		{
+			min = d;
+			best = i;
+		}
 	}
+
+	return best;
 }
+#endif
 
+#if !(defined(HOST) && HOST) && !(defined(WS2812_SPI) && WS2812_SPI)
 static void ws2812(uint8_t *pixels, uint16_t count, uint8_t pin)
 {
-	uint8_t b, c, h, l, s;
+	uint8_t *p, b, c, h, l, s, i;
 	h = (1 << pin);
 	WS2812_DIR |= h;
 	l = ~h & WS2812_OUT;
@@ -113,12 +556,15 @@ static void ws2812(uint8_t *pixels, uint16_t count, uint8_t pin)
 	asm volatile ("cli");
 	while(count--)
 	{
-		b = *pixels++;
-		asm volatile
-		(
-			"       ldi   %0,8  \n\t"
-			"loop%=:            \n\t"
-			"       out   %2,%3 \n\t"
+		p = LED_FETCH(pixels);
+		for(i = 0; i < LED_CHANNELS; ++i)
+		{
+			b = LED_OUT(p[i]);
+			asm volatile
+			(
+				"       ldi   %0,8  \n\t"
+				"loop%=:            \n\t"
+				"       out   %2,%3 \n\t"
 #if (W1_NOPS & 1)
 W_NOP1
 #endif
@@ -134,9 +580,9 @@ W_NOP8
 #if (W1_NOPS & 16)
 W_NOP16
 #endif
-			"       sbrs  %1,7  \n\t"
-			"       out   %2,%4 \n\t"
-			"       lsl   %1    \n\t"
+				"       sbrs  %1,7  \n\t"
+				"       out   %2,%4 \n\t"
+				"       lsl   %1    \n\t"
 #if (W2_NOPS & 1)
 W_NOP1
 #endif
@@ -152,7 +598,7 @@ W_NOP8
 #if (W2_NOPS & 16)
 W_NOP16
 #endif
-			"       out   %2,%4 \n\t"
+				"       out   %2,%4 \n\t"
 #if (W3_NOPS & 1)
 W_NOP1
 #endif
@@ -168,16 +614,240 @@ W_NOP8
 #if (W3_NOPS & 16)
 W_NOP16
 #endif
-			"       dec   %0    \n\t"
-			"       brne  loop%=\n\t"
-			:	"=&d" (c)
-			:	"r" (b),
-				"I" (_SFR_IO_ADDR(WS2812_OUT)),
-				"r" (h),
-				"r" (l)
-		);
+				"       dec   %0    \n\t"
+				"       brne  loop%=\n\t"
+				:	"=&d" (c)
+				:	"r" (b),
+					"I" (_SFR_IO_ADDR(WS2812_OUT)),
+					"r" (h),
+					"r" (l)
+			);
+		}
+
+#if defined(WS2812_IRQ_WINDOW) && WS2812_IRQ_WINDOW
+		/* Service pending interrupts between two pixels. The low time
+		   this adds must stay below the latch time (>= 50 us). */
+		SREG = s;
+		asm volatile ("nop\n\tcli");
+#endif
 	}
 
 	SREG = s;
 }
+#endif
 
+#if !(defined(HOST) && HOST) && !(defined(WS2812_SPI) && WS2812_SPI) && \
+	defined(WS2812_DUAL) && WS2812_DUAL
+static void ws2812_dual(uint8_t *a, uint8_t *b, uint16_t count)
+{
+	uint8_t *pa, *pb, x, y, c, m, h, l, s, i;
+	h = (1 << WS2812_PIN_A) | (1 << WS2812_PIN_B);
+	WS2812_DIR |= h;
+	l = ~h & WS2812_OUT;
+	h |= WS2812_OUT;
+	s = SREG;
+	asm volatile ("cli");
+	while(count--)
+	{
+		pa = LED_FETCH(a);
+		pb = LED_FETCH(b);
+		for(i = 0; i < LED_CHANNELS; ++i)
+		{
+			x = LED_OUT(pa[i]);
+			y = LED_OUT(pb[i]);
+			m = l;
+			asm volatile
+			(
+				"       ldi   %0,8  \n\t"
+				"       bst   %2,7  \n\t"
+				"       bld   %1,%7 \n\t"
+				"       bst   %3,7  \n\t"
+				"       bld   %1,%8 \n\t"
+				"loop%=:            \n\t"
+				"       out   %4,%5 \n\t"
+#if (WD1_NOPS & 1)
+W_NOP1
+#endif
+#if (WD1_NOPS & 2)
+W_NOP2
+#endif
+#if (WD1_NOPS & 4)
+W_NOP4
+#endif
+#if (WD1_NOPS & 8)
+W_NOP8
+#endif
+#if (WD1_NOPS & 16)
+W_NOP16
+#endif
+				"       out   %4,%1 \n\t"
+#if (WD_PRE >= 1)
+WD_OP1
+#endif
+#if (WD_PRE >= 2)
+WD_OP2
+#endif
+#if (WD_PRE >= 3)
+WD_OP3
+#endif
+#if (WD_PRE >= 4)
+WD_OP4
+#endif
+#if (WD_PRE >= 5)
+WD_OP5
+#endif
+#if (WD_PRE >= 6)
+WD_OP6
+#endif
+#if (WD2_NOPS & 1)
+W_NOP1
+#endif
+#if (WD2_NOPS & 2)
+W_NOP2
+#endif
+#if (WD2_NOPS & 4)
+W_NOP4
+#endif
+#if (WD2_NOPS & 8)
+W_NOP8
+#endif
+#if (WD2_NOPS & 16)
+W_NOP16
+#endif
+				"       out   %4,%6 \n\t"
+#if (WD_PRE < 1)
+WD_OP1
+#endif
+#if (WD_PRE < 2)
+WD_OP2
+#endif
+#if (WD_PRE < 3)
+WD_OP3
+#endif
+#if (WD_PRE < 4)
+WD_OP4
+#endif
+#if (WD_PRE < 5)
+WD_OP5
+#endif
+#if (WD_PRE < 6)
+WD_OP6
+#endif
+#if (WD3_NOPS & 1)
+W_NOP1
+#endif
+#if (WD3_NOPS & 2)
+W_NOP2
+#endif
+#if (WD3_NOPS & 4)
+W_NOP4
+#endif
+#if (WD3_NOPS & 8)
+W_NOP8
+#endif
+#if (WD3_NOPS & 16)
+W_NOP16
+#endif
+				"       dec   %0    \n\t"
+				"       brne  loop%=\n\t"
+				:	"=&d" (c),
+					"+r" (m),
+					"+r" (x),
+					"+r" (y)
+				:	"I" (_SFR_IO_ADDR(WS2812_OUT)),
+					"r" (h),
+					"r" (l),
+					"I" (WS2812_PIN_A),
+					"I" (WS2812_PIN_B)
+			);
+		}
+
+#if defined(WS2812_IRQ_WINDOW) && WS2812_IRQ_WINDOW
+		SREG = s;
+		asm volatile ("nop\n\tcli");
+#endif
+	}
+
+	SREG = s;
+}
+#endif
+
+#if !(defined(HOST) && HOST) && defined(WS2812_SPI) && WS2812_SPI
+static void ws2812_spi(uint8_t *pixels, uint16_t count)
+{
+	static const uint8_t sym[4] =
+	{
+		0x88,
+		0x80 | WS_SPI_ONE,
+		(WS_SPI_ONE << 4) | 0x08,
+		(WS_SPI_ONE << 4) | WS_SPI_ONE
+	};
+
+	uint8_t *p, b, d, i, j;
+	WS2812_SPI_PORT &= ~(1 << WS2812_SPI_MOSI);
+	WS2812_SPI_DDR |= (1 << WS2812_SPI_MOSI) | (1 << WS2812_SPI_SCK) |
+		(1 << WS2812_SPI_SS);
+
+	SPCR = (1 << SPE) | (1 << MSTR) | WS_SPI_SPCR;
+	SPSR = WS_SPI_SPSR;
+	SPDR = 0;
+	while(count--)
+	{
+		p = LED_FETCH(pixels);
+		for(j = 0; j < LED_CHANNELS; ++j)
+		{
+			b = LED_OUT(p[j]);
+			for(i = 0; i < 4; ++i)
+			{
+				d = sym[b >> 6];
+				b <<= 2;
+				while(!(SPSR & (1 << SPIF))) ;
+				SPDR = d;
+			}
+		}
+	}
+
+	while(!(SPSR & (1 << SPIF))) ;
+	SPCR = 0;
+}
+#endif
+
+#if defined(HOST) && HOST
+/* Host build: the frame is converted back to colours in strip order,
+   after gamma correction and brightness, and passed to the simulation */
+#define HOST_ADD(a, b)        ((a) + (b) > 255 ? 255 : (a) + (b))
+
+void host_show(color_t *strip, uint16_t count);
+
+static void ws2812_host(uint8_t *pixels, uint16_t count)
+{
+	static color_t strip[LED_PIXELS];
+	uint8_t *p, w[LED_CHANNELS], i;
+	uint16_t n;
+	for(n = 0; n < count; ++n)
+	{
+		p = LED_FETCH(pixels);
+		for(i = 0; i < LED_CHANNELS; ++i)
+		{
+			w[i] = LED_OUT(p[i]);
+		}
+
+#if W_CHIP(LED_CHIPSET, GRB)
+		strip[n].G = w[0];
+		strip[n].R = w[1];
+#else
+		strip[n].R = w[0];
+		strip[n].G = w[1];
+#endif
+		strip[n].B = w[2];
+
+#if (LED_CHANNELS == 4)
+		strip[n].R = HOST_ADD(strip[n].R, w[3]);
+		strip[n].G = HOST_ADD(strip[n].G, w[3]);
+		strip[n].B = HOST_ADD(strip[n].B, w[3]);
+#endif
+	}
+
+	host_show(strip, count);
+}
+#endif
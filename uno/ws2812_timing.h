@@ -0,0 +1,141 @@
+/* Bit timing of the WS2812 output backends. Shared by ws2812.c and the
+   host side timing table (timing.c), so every macro takes the clock
+   frequency and the chipset as arguments. All times are in ns. */
+
+/* WS2812B, GRB */
+#define WS2812B_CHANNELS       3
+#define WS2812B_GRB            1
+#define WS2812B_T0H          350
+#define WS2812B_T1H          900
+#define WS2812B_PERIOD      1250
+#define WS2812B_T0H_MIN      250
+#define WS2812B_T0H_MAX      550
+#define WS2812B_T1H_MIN      650
+#define WS2812B_T1H_MAX      950
+#define WS2812B_PERIOD_MIN   650
+#define WS2812B_PERIOD_MAX  1850
+
+/* SK6812 RGBW, GRBW */
+#define SK6812_CHANNELS        4
+#define SK6812_GRB             1
+#define SK6812_T0H           300
+#define SK6812_T1H           600
+#define SK6812_PERIOD       1250
+#define SK6812_T0H_MIN       150
+#define SK6812_T0H_MAX       450
+#define SK6812_T1H_MIN       450
+#define SK6812_T1H_MAX       750
+#define SK6812_PERIOD_MIN    650
+#define SK6812_PERIOD_MAX   1850
+
+/* WS2811 low speed mode (400 kHz), RGB */
+#define WS2811_CHANNELS        3
+#define WS2811_GRB             0
+#define WS2811_T0H           500
+#define WS2811_T1H          1200
+#define WS2811_PERIOD       2500
+#define WS2811_T0H_MIN       350
+#define WS2811_T0H_MAX       650
+#define WS2811_T1H_MIN      1050
+#define WS2811_T1H_MAX      1350
+#define WS2811_PERIOD_MIN   1900
+#define WS2811_PERIOD_MAX   3100
+
+#define W_PASTE(c, p)         c##_##p
+#define W_CHIP(c, p)          W_PASTE(c, p)
+
+#define W_CYCLES(f, t) \
+	(((f) / 1000 * (t)) / 1000000)
+
+#define W_CYCLES_R(f, t) \
+	(((f) / 1000 * (t) + 500000) / 1000000)
+
+#define W_TIME(f, n) \
+	(((n) * 1000000) / ((f) / 1000))
+
+#define W_POS(v)              ((v) > 0 ? (v) : 0)
+
+/* Single lane: cycles of the loop outside the NOP blocks */
+#define W_FIXED_LOW       2
+#define W_FIXED_HIGH      4
+#define W_FIXED_TOTAL     8
+
+#define W1_OF(f, c) \
+	W_POS(W_CYCLES(f, W_CHIP(c, T0H)) - W_FIXED_LOW)
+
+#define W2_OF(f, c) \
+	W_POS(W_CYCLES_R(f, W_CHIP(c, T1H)) - W_FIXED_HIGH - W1_OF(f, c))
+
+#define W3_OF(f, c) \
+	W_POS(W_CYCLES_R(f, W_CHIP(c, PERIOD)) - W_FIXED_TOTAL - \
+		W1_OF(f, c) - W2_OF(f, c))
+
+#define W_T0H_OF(f, c) \
+	W_TIME(f, W1_OF(f, c) + W_FIXED_LOW)
+
+#define W_T1H_OF(f, c) \
+	W_TIME(f, W1_OF(f, c) + W2_OF(f, c) + W_FIXED_HIGH)
+
+#define W_PERIOD_OF(f, c) \
+	W_TIME(f, W1_OF(f, c) + W2_OF(f, c) + W3_OF(f, c) + W_FIXED_TOTAL)
+
+/* Dual lane: both halves are shifted out in the same loop. The port value
+   for the next bit is prepared with WD_OPS instructions, as many of them
+   as fit are placed in the high time of a one (WD_PRE), the rest extend
+   the low time. WD2 counts all cycles between the two falling edges. */
+#define WD_FIXED_LOW      1
+#define WD_FIXED_HIGH     2
+#define WD_FIXED_TOTAL   12
+#define WD_OPS            6
+
+#define WD1_OF(f, c) \
+	W_POS(W_CYCLES(f, W_CHIP(c, T0H)) - WD_FIXED_LOW)
+
+#define WD2_OF(f, c) \
+	W_POS(W_CYCLES_R(f, W_CHIP(c, T1H)) - WD_FIXED_HIGH - WD1_OF(f, c))
+
+#define WD_PRE_OF(f, c) \
+	(WD2_OF(f, c) > WD_OPS ? WD_OPS : WD2_OF(f, c))
+
+#define WD2_NOPS_OF(f, c) \
+	(WD2_OF(f, c) - WD_PRE_OF(f, c))
+
+#define WD3_OF(f, c) \
+	W_POS(W_CYCLES_R(f, W_CHIP(c, PERIOD)) - WD_FIXED_TOTAL - \
+		WD1_OF(f, c) - WD2_NOPS_OF(f, c))
+
+#define WD_T0H_OF(f, c) \
+	W_TIME(f, WD1_OF(f, c) + WD_FIXED_LOW)
+
+#define WD_T1H_OF(f, c) \
+	W_TIME(f, WD1_OF(f, c) + WD2_OF(f, c) + WD_FIXED_HIGH)
+
+#define WD_PERIOD_OF(f, c) \
+	W_TIME(f, WD1_OF(f, c) + WD2_NOPS_OF(f, c) + WD3_OF(f, c) + \
+		WD_FIXED_TOTAL)
+
+/* SPI: every bit is sent as a 4 bit symbol, 1000 for a zero and 1110
+   (or 1100 if that is too long) for a one, two bits per SPI byte. Gaps
+   between SPI bytes stretch the low time of every second bit. */
+#define WS_SPI_DIV_OF(f) \
+	((f) <= 8000000 ? 2 : (f) <= 16000000 ? 4 : 8)
+
+#define WS_SPI_ONE_OF(f, c) \
+	(W_TIME(f, 3 * WS_SPI_DIV_OF(f)) <= W_CHIP(c, T1H_MAX) ? 3 : 2)
+
+#define WS_SPI_T0H_OF(f, c) \
+	W_TIME(f, WS_SPI_DIV_OF(f))
+
+#define WS_SPI_T1H_OF(f, c) \
+	W_TIME(f, WS_SPI_ONE_OF(f, c) * WS_SPI_DIV_OF(f))
+
+#define WS_SPI_PERIOD_OF(f, c) \
+	W_TIME(f, 4 * WS_SPI_DIV_OF(f))
+
+/* 2: in spec, 1: T1H or period out of spec, 0: T0H out of spec, ws2812.c
+   refuses to build with anything but 2 */
+#define W_CHECK(c, t0h, t1h, period) \
+	(((t0h) < W_CHIP(c, T0H_MIN) || (t0h) > W_CHIP(c, T0H_MAX)) ? 0 : \
+	((t1h) < W_CHIP(c, T1H_MIN) || (t1h) > W_CHIP(c, T1H_MAX) || \
+	(period) < W_CHIP(c, PERIOD_MIN) || \
+	(period) > W_CHIP(c, PERIOD_MAX)) ? 1 : 2)